@@ -4,8 +4,8 @@
 #include <functional>
 #include <algorithm>
 #include <thread>
-#include <concurrentqueue.h> //https://github.com/cameron314/concurrentqueue
 #include "Aligner.h"
+#include "BlockingQueue.h"
 #include "CommonUtils.h"
 #include "vg.pb.h"
 #include "stream.hpp"
@@ -14,27 +14,107 @@
 #include "ThreadReadAssertion.h"
 #include "GraphAlignerWrapper.h"
 #include "MummerSeeder.h"
+#include "MinimizerSeeder.h"
+#include "GamBlockWriter.h"
+#include "ReorderQueue.h"
+
+//reads are handed to the aligner threads in batches of at most this many reads or base pairs
+const size_t ReadBatchMaxReads = 100;
+const size_t ReadBatchMaxBp = 50000;
+//compressed alignment blocks waiting to be written, per aligner thread
+const size_t OutputBlocksInFlightPerThread = 4;
+//input files are parsed concurrently, at most this many at a time
+const size_t MaxParallelReadFiles = 4;
+//with ordered output, an aligner thread waits if its batch is this many batches per thread ahead of the oldest unwritten batch
+const size_t ReorderWindowPerThread = 4;
+
+//consecutive reads from one input file, aligned by one aligner thread
+//with ordered output the batches are numbered in the input order
+struct ReadBatch
+{
+	size_t batchNumber;
+	std::vector<FastQ> reads;
+};
+
+//where the aligner threads send their alignments
+//the alignments are compressed on the aligner threads. unordered blocks are written as soon as they are full,
+//ordered blocks are split by the read batches and sent per batch to the writer thread which restores the input order
+class AlignmentSink
+{
+public:
+	AlignmentSink(bool ordered, BlockingQueue<std::string>& blocks, ReorderQueue<std::vector<std::string>>& orderedBatches, BufferPool& bufferPool) :
+	ordered(ordered),
+	blocks(blocks),
+	orderedBatches(orderedBatches),
+	compressor(bufferPool),
+	batchBlocks()
+	{
+	}
+	void add(const vg::Alignment& alignment)
+	{
+		compressor.add(alignment);
+	}
+	//must be called for every read, including the reads without alignments
+	void finishRead()
+	{
+		if (!compressor.full()) return;
+		if (ordered)
+		{
+			batchBlocks.push_back(compressor.compress());
+		}
+		else
+		{
+			blocks.push(compressor.compress());
+		}
+	}
+	//must be called for every batch. the block boundaries depend only on the batch so the output doesn't depend on the number of threads
+	void finishBatch(size_t batchNumber)
+	{
+		if (!ordered) return;
+		if (!compressor.empty()) batchBlocks.push_back(compressor.compress());
+		orderedBatches.push(batchNumber, std::move(batchBlocks));
+		batchBlocks = std::vector<std::string> {};
+	}
+	void finish()
+	{
+		if (!ordered && !compressor.empty()) blocks.push(compressor.compress());
+	}
+private:
+	bool ordered;
+	BlockingQueue<std::string>& blocks;
+	ReorderQueue<std::vector<std::string>>& orderedBatches;
+	GamBlockCompressor compressor;
+	std::vector<std::string> batchBlocks;
+};
 
 struct Seeder
 {
 	enum Mode
 	{
-		File, Mum, Mem, None
+		File, Mum, Mem, Minimizer, None
 	};
 	Mode mode;
 	size_t mumCount;
 	size_t memCount;
 	size_t mxmLength;
 	const MummerSeeder* mummerSeeder;
+	const MinimizerSeeder* minimizerSeeder;
 	const std::unordered_map<std::string, std::vector<SeedHit>>* fileSeeds;
-	Seeder(const AlignerParams& params, const std::unordered_map<std::string, std::vector<SeedHit>>* fileSeeds, const MummerSeeder* mummerSeeder) :
+	Seeder(const AlignerParams& params, const std::unordered_map<std::string, std::vector<SeedHit>>* fileSeeds, const MummerSeeder* mummerSeeder, const MinimizerSeeder* minimizerSeeder) :
 		mumCount(params.mumCount),
 		memCount(params.memCount),
 		mxmLength(params.mxmLength),
 		mummerSeeder(mummerSeeder),
+		minimizerSeeder(minimizerSeeder),
 		fileSeeds(fileSeeds)
 	{
 		mode = Mode::None;
+		if (minimizerSeeder != nullptr)
+		{
+			assert(fileSeeds == nullptr);
+			assert(mummerSeeder == nullptr);
+			mode = Mode::Minimizer;
+		}
 		if (fileSeeds != nullptr)
 		{
 			assert(mummerSeeder == nullptr);
@@ -72,6 +152,9 @@ struct Seeder
 			case Mode::Mem:
 				assert(mummerSeeder != nullptr);
 				return mummerSeeder->getMemSeeds(seq, memCount, mxmLength);
+			case Mode::Minimizer:
+				assert(minimizerSeeder != nullptr);
+				return minimizerSeeder->getSeeds(seq);
 			case Mode::None:
 				assert(false);
 		}
@@ -142,29 +225,69 @@ void writeTrace(const std::vector<AlignmentResult::TraceItem>& trace, const std:
 	}
 }
 
-void readFastqs(const std::vector<std::string>& filenames, moodycamel::ConcurrentQueue<std::shared_ptr<FastQ>>& writequeue, std::atomic<bool>& readStreamingFinished)
+//with ordered output the files are parsed one at a time so the batches and their numbers follow the input order
+void readFastqs(const std::vector<std::string>& filenames, BlockingQueue<ReadBatch>& writequeue, size_t decompressionThreads, bool ordered)
 {
-	assertSetRead("Read streamer", "No seed");
-	for (auto filename : filenames)
+	std::atomic<size_t> nextFile { 0 };
+	std::atomic<size_t> nextBatchNumber { 0 };
+	std::vector<std::thread> fileThreads;
+	for (size_t i = 0; i < std::min(filenames.size(), ordered ? 1 : MaxParallelReadFiles); i++)
 	{
-		FastQ::streamFastqFromFile(filename, false, [&writequeue](FastQ& read)
+		fileThreads.emplace_back([&filenames, &writequeue, &nextFile, &nextBatchNumber, decompressionThreads]()
 		{
-			std::shared_ptr<FastQ> ptr = std::make_shared<FastQ>();
-			std::swap(*ptr, read);
-			writequeue.enqueue(ptr);
+			assertSetRead("Read streamer", "No seed");
+			while (true)
+			{
+				size_t fileIndex = nextFile++;
+				if (fileIndex >= filenames.size()) break;
+				try
+				{
+					FastqReader reader { filenames[fileIndex], false, decompressionThreads };
+					ReadBatch batch;
+					size_t batchBp = 0;
+					FastQ read;
+					while (reader.next(read))
+					{
+						batchBp += read.sequence.size();
+						batch.reads.emplace_back(std::move(read));
+						if (batch.reads.size() >= ReadBatchMaxReads || batchBp >= ReadBatchMaxBp)
+						{
+							batch.batchNumber = nextBatchNumber++;
+							writequeue.push(std::move(batch), batchBp);
+							batch = ReadBatch {};
+							batchBp = 0;
+						}
+					}
+					if (batch.reads.size() > 0)
+					{
+						batch.batchNumber = nextBatchNumber++;
+						writequeue.push(std::move(batch), batchBp);
+					}
+				}
+				catch (const CommonUtils::InvalidReadFileException& e)
+				{
+					std::cout << "Error in the read file: " << e.what() << std::endl;
+					std::cerr << "Error in the read file: " << e.what() << std::endl;
+					std::exit(1);
+				}
+			}
 		});
 	}
-	readStreamingFinished = true;
+	for (size_t i = 0; i < fileThreads.size(); i++)
+	{
+		fileThreads[i].join();
+	}
+	writequeue.close();
 }
 
-void consumeVGsAndWrite(const std::string& filename, moodycamel::ConcurrentQueue<std::string*>& writequeue, moodycamel::ConcurrentQueue<std::string*>& deallocqueue, std::atomic<bool>& allThreadsDone, std::atomic<bool>& allWriteDone, bool verboseMode)
+void consumeVGsAndWrite(const std::string& filename, BlockingQueue<std::string>& writequeue, BufferPool& bufferPool, bool verboseMode)
 {
 	assertSetRead("Writer", "No seed");
 	std::ofstream outfile { filename, std::ios::binary | std::ios::out };
 
 	bool wroteAny = false;
 
-	std::string* alns[100] {};
+	std::vector<std::string> blocks;
 
 	BufferedWriter coutoutput;
 	if (verboseMode)
@@ -174,47 +297,71 @@ void consumeVGsAndWrite(const std::string& filename, moodycamel::ConcurrentQueue
 
 	while (true)
 	{
-		size_t gotAlns = writequeue.try_dequeue_bulk(alns, 100);
-		if (gotAlns == 0)
+		blocks.clear();
+		size_t gotBlocks = writequeue.popBatch(blocks, std::numeric_limits<size_t>::max());
+		if (gotBlocks == 0) break;
+		coutoutput << "write " << gotBlocks << " blocks, " << writequeue.size() << " left" << BufferedWriter::Flush;
+		for (size_t i = 0; i < gotBlocks; i++)
 		{
-			if (!writequeue.try_dequeue(alns[0]))
-			{
-				if (allThreadsDone) break;
-				std::this_thread::sleep_for(std::chrono::milliseconds(10));
-				continue;
-			}
-			gotAlns = 1;
+			outfile.write(blocks[i].data(), blocks[i].size());
+			bufferPool.release(std::move(blocks[i]));
 		}
-		coutoutput << "write " << gotAlns << ", " << writequeue.size_approx() << " left" << BufferedWriter::Flush;
-		for (size_t i = 0; i < gotAlns; i++)
-		{
-			outfile.write(alns[i]->data(), alns[i]->size());
-		}
-		deallocqueue.enqueue_bulk(alns, gotAlns);
 		wroteAny = true;
 	}
 
 	if (!wroteAny)
 	{
-		::google::protobuf::io::ZeroCopyOutputStream *raw_out =
-		      new ::google::protobuf::io::OstreamOutputStream(&outfile);
-		::google::protobuf::io::GzipOutputStream *gzip_out =
-		      new ::google::protobuf::io::GzipOutputStream(raw_out);
-		::google::protobuf::io::CodedOutputStream *coded_out =
-		      new ::google::protobuf::io::CodedOutputStream(gzip_out);
-		coded_out->WriteVarint64(0);
-		delete coded_out;
-		delete gzip_out;
-		delete raw_out;
+		GamBlockCompressor compressor { bufferPool };
+		std::string emptyBlock = compressor.compress();
+		outfile.write(emptyBlock.data(), emptyBlock.size());
+	}
+}
+
+void consumeOrderedAndWrite(const std::string& filename, ReorderQueue<std::vector<std::string>>& writequeue, BufferPool& bufferPool, bool verboseMode)
+{
+	assertSetRead("Writer", "No seed");
+	std::ofstream outfile { filename, std::ios::binary | std::ios::out };
+
+	bool wroteAny = false;
+
+	std::vector<std::vector<std::string>> batches;
+
+	BufferedWriter coutoutput;
+	if (verboseMode)
+	{
+		coutoutput = {std::cout};
 	}
 
-	allWriteDone = true;
+	while (true)
+	{
+		batches.clear();
+		size_t gotBatches = writequeue.popBatch(batches, std::numeric_limits<size_t>::max());
+		if (gotBatches == 0) break;
+		coutoutput << "write " << gotBatches << " read batches" << BufferedWriter::Flush;
+		for (size_t i = 0; i < gotBatches; i++)
+		{
+			for (size_t j = 0; j < batches[i].size(); j++)
+			{
+				outfile.write(batches[i][j].data(), batches[i][j].size());
+				bufferPool.release(std::move(batches[i][j]));
+				wroteAny = true;
+			}
+		}
+	}
+
+	if (!wroteAny)
+	{
+		GamBlockCompressor compressor { bufferPool };
+		std::string emptyBlock = compressor.compress();
+		outfile.write(emptyBlock.data(), emptyBlock.size());
+	}
 }
 
-void runComponentMappings(const AlignmentGraph& alignmentGraph, moodycamel::ConcurrentQueue<std::shared_ptr<FastQ>>& readFastqsQueue, std::atomic<bool>& readStreamingFinished, int threadnum, const Seeder& seeder, AlignerParams params, moodycamel::ConcurrentQueue<std::string*>& alignmentsOut, moodycamel::ProducerToken& token, moodycamel::ConcurrentQueue<std::string*>& deallocqueue, AlignmentStats& stats)
+template <typename LengthType, typename Word>
+void runComponentMappings(const AlignmentGraph& alignmentGraph, BlockingQueue<ReadBatch>& readFastqsQueue, int threadnum, const Seeder& seeder, AlignerParams params, AlignmentSink& alignmentsOut, AlignmentStats& stats)
 {
 	assertSetRead("Before any read", "No seed");
-	GraphAlignerCommon<size_t, int32_t, uint64_t>::AlignerGraphsizedState reusableState { alignmentGraph, std::max(params.initialBandwidth, params.rampBandwidth), !params.highMemory };
+	typename GraphAlignerCommon<LengthType, int32_t, Word>::AlignerGraphsizedState reusableState { alignmentGraph, std::max(params.initialBandwidth, params.rampBandwidth), !params.highMemory };
 	BufferedWriter cerroutput;
 	BufferedWriter coutoutput;
 	if (params.verboseMode)
@@ -222,21 +369,19 @@ void runComponentMappings(const AlignmentGraph& alignmentGraph, moodycamel::Conc
 		cerroutput = {std::cerr};
 		coutoutput = {std::cout};
 	}
+	std::vector<ReadBatch> readBatch;
+	size_t batchIndex = 0;
 	while (true)
 	{
-		std::string* dealloc;
-		while (deallocqueue.try_dequeue(dealloc))
-		{
-			delete dealloc;
-		}
-		std::shared_ptr<FastQ> fastq = nullptr;
-		while (!readFastqsQueue.try_dequeue(fastq))
+		if (readBatch.size() == 0 || batchIndex == readBatch[0].reads.size())
 		{
-			bool tryBreaking = readStreamingFinished;
-			if (!readFastqsQueue.try_dequeue(fastq) && tryBreaking) break;
-			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			if (readBatch.size() > 0) alignmentsOut.finishBatch(readBatch[0].batchNumber);
+			readBatch.clear();
+			batchIndex = 0;
+			if (readFastqsQueue.popBatch(readBatch, 1) == 0) break;
 		}
-		if (fastq == nullptr) break;
+		const FastQ* fastq = &readBatch[0].reads[batchIndex];
+		batchIndex += 1;
 		assertSetRead(fastq->seq_id, "No seed");
 		coutoutput << "Read " << fastq->seq_id << " size " << fastq->sequence.size() << "bp" << BufferedWriter::Flush;
 		stats.reads += 1;
@@ -260,16 +405,17 @@ void runComponentMappings(const AlignmentGraph& alignmentGraph, moodycamel::Conc
 					cerroutput << "Read " << fastq->seq_id << " has no seed hits" << BufferedWriter::Flush;
 					coutoutput << "Read " << fastq->seq_id << " alignment failed" << BufferedWriter::Flush;
 					cerroutput << "Read " << fastq->seq_id << " alignment failed" << BufferedWriter::Flush;
+					alignmentsOut.finishRead();
 					continue;
 				}
 				stats.seedsFound += seeds.size();
 				stats.readsWithASeed += 1;
 				stats.bpInReadsWithASeed += fastq->sequence.size();
-				alignments = AlignOneWay(alignmentGraph, fastq->seq_id, fastq->sequence, params.initialBandwidth, params.rampBandwidth, params.maxCellsPerSlice, !params.verboseMode, !params.tryAllSeeds, seeds, reusableState, !params.highMemory);
+				alignments = AlignOneWay(alignmentGraph, fastq->seq_id, fastq->sequence, params.initialBandwidth, params.rampBandwidth, params.maxCellsPerSlice, !params.verboseMode, !params.tryAllSeeds, seeds, reusableState, !params.highMemory, params.checkpointSlices, params.tryAllSeeds && !params.outputAllAlns, params.joinExtendedSeeds);
 			}
 			else
 			{
-				alignments = AlignOneWay(alignmentGraph, fastq->seq_id, fastq->sequence, params.initialBandwidth, params.rampBandwidth, !params.verboseMode, reusableState, !params.highMemory);
+				alignments = AlignOneWay(alignmentGraph, fastq->seq_id, fastq->sequence, params.initialBandwidth, params.rampBandwidth, !params.verboseMode, reusableState, !params.highMemory, params.checkpointSlices, false);
 			}
 		}
 		catch (const ThreadReadAssertion::AssertionFailure& a)
@@ -278,6 +424,7 @@ void runComponentMappings(const AlignmentGraph& alignmentGraph, moodycamel::Conc
 			cerroutput << "Read " << fastq->seq_id << " alignment failed (assertion!)" << BufferedWriter::Flush;
 			reusableState.clear();
 			stats.assertionBroke = true;
+			alignmentsOut.finishRead();
 			continue;
 		}
 
@@ -286,6 +433,7 @@ void runComponentMappings(const AlignmentGraph& alignmentGraph, moodycamel::Conc
 		{
 			coutoutput << "Read " << fastq->seq_id << " alignment failed" << BufferedWriter::Flush;
 			cerroutput << "Read " << fastq->seq_id << " alignment failed" << BufferedWriter::Flush;
+			alignmentsOut.finishRead();
 			continue;
 		}
 
@@ -302,14 +450,6 @@ void runComponentMappings(const AlignmentGraph& alignmentGraph, moodycamel::Conc
 		std::string alignmentpositions;
 		size_t timems = 0;
 		size_t totalcells = 0;
-		std::stringstream strstr;
-		::google::protobuf::io::ZeroCopyOutputStream *raw_out =
-		      new ::google::protobuf::io::OstreamOutputStream(&strstr);
-		::google::protobuf::io::GzipOutputStream *gzip_out =
-		      new ::google::protobuf::io::GzipOutputStream(raw_out);
-		::google::protobuf::io::CodedOutputStream *coded_out =
-		      new ::google::protobuf::io::CodedOutputStream(gzip_out);
-		coded_out->WriteVarint64(alignments.alignments.size());
 		for (size_t i = 0; i < alignments.alignments.size(); i++)
 		{
 			try
@@ -334,36 +474,21 @@ void runComponentMappings(const AlignmentGraph& alignmentGraph, moodycamel::Conc
 			alignmentpositions += std::to_string(alignments.alignments[i].alignmentStart) + "-" + std::to_string(alignments.alignments[i].alignmentEnd) + ", ";
 			timems += alignments.alignments[i].elapsedMilliseconds;
 			totalcells += alignments.alignments[i].cellsProcessed;
-			std::string s;
-			alignments.alignments[i].alignment->SerializeToString(&s);
-			coded_out->WriteVarint32(s.size());
-			coded_out->WriteRaw(s.data(), s.size());
-		}
-		delete coded_out;
-		delete gzip_out;
-		delete raw_out;
-		std::string* writeAlns = new std::string { strstr.str() };
-		size_t waited = 0;
-		while (!alignmentsOut.try_enqueue(token, writeAlns) && !alignmentsOut.try_enqueue(writeAlns))
-		{
-			std::this_thread::sleep_for(std::chrono::milliseconds(10));
-			waited++;
-			if (waited >= 1000)
-			{
-				if (alignmentsOut.size_approx() < 100 && alignmentsOut.enqueue(writeAlns)) break;
-			}
+			alignmentsOut.add(*alignments.alignments[i].alignment);
 		}
+		alignmentsOut.finishRead();
 		alignmentpositions.pop_back();
 		alignmentpositions.pop_back();
 
 		coutoutput << "Read " << fastq->seq_id << " alignment took " << timems << "ms" << BufferedWriter::Flush;
 		coutoutput << "Read " << fastq->seq_id << " aligned by thread " << threadnum << " with positions: " << alignmentpositions << " (read " << fastq->sequence.size() << "bp)" << BufferedWriter::Flush;
 	}
+	alignmentsOut.finish();
 	assertSetRead("After all reads", "No seed");
 	coutoutput << "Thread " << threadnum << " finished" << BufferedWriter::Flush;
 }
 
-AlignmentGraph getGraph(std::string graphFile, MummerSeeder** seeder, bool loadSeeder, bool tryDAG, const std::string& seederCachePrefix)
+AlignmentGraph getGraph(std::string graphFile, MummerSeeder** seeder, bool loadSeeder, bool tryDAG, bool localityOrder, const std::string& seederCachePrefix, size_t mxmLength, const std::string& graphIndexFile)
 {
 	if (is_file_exist(graphFile)){
 		std::cout << "Load graph from " << graphFile << std::endl;
@@ -372,37 +497,41 @@ AlignmentGraph getGraph(std::string graphFile, MummerSeeder** seeder, bool loadS
 		std::cerr << "No graph file exists" << std::endl;
 		std::exit(0);
 	}
+	bool isVG = graphFile.size() >= 3 && graphFile.substr(graphFile.size()-3) == ".vg";
+	bool isGFA = graphFile.size() >= 4 && graphFile.substr(graphFile.size() - 4) == ".gfa";
+	if (!isVG && !isGFA)
+	{
+		std::cerr << "Unknown graph type (" << graphFile << ")" << std::endl;
+		std::exit(0);
+	}
 	try
 	{
-		if (graphFile.substr(graphFile.size()-3) == ".vg")
+		GraphFingerprint fingerprint = GraphFingerprint::FromFile(graphFile);
+		AlignmentGraph result;
+		bool indexed = graphIndexFile.size() > 0 && result.LoadFrom(graphIndexFile, fingerprint, tryDAG, localityOrder);
+		if (indexed) std::cout << "Loaded the graph from the index " << graphIndexFile << std::endl;
+		if (!indexed)
 		{
-			if (loadSeeder)
+			if (isVG)
 			{
-				auto graph = CommonUtils::LoadVGGraph(graphFile);
-				std::cout << "Build seeder from the graph" << std::endl;
-				*seeder = new MummerSeeder { graph, seederCachePrefix };
-				return DirectedGraph::BuildFromVG(graph, tryDAG);
+				result = DirectedGraph::StreamVGGraphFromFile(graphFile, tryDAG, localityOrder);
 			}
 			else
 			{
-				return DirectedGraph::StreamVGGraphFromFile(graphFile, tryDAG);
+				result = DirectedGraph::StreamGFAGraphFromFile(graphFile, tryDAG, localityOrder);
 			}
-		}
-		else if (graphFile.substr(graphFile.size() - 4) == ".gfa")
-		{
-			auto graph = GfaGraph::LoadFromFile(graphFile, true);
-			if (loadSeeder)
+			if (graphIndexFile.size() > 0)
 			{
-				std::cout << "Build seeder from the graph" << std::endl;
-				*seeder = new MummerSeeder { graph, seederCachePrefix };
+				std::cout << "Write the graph index to " << graphIndexFile << std::endl;
+				if (!result.SaveTo(graphIndexFile, fingerprint, tryDAG, localityOrder)) std::cerr << "Could not write the graph index to " << graphIndexFile << std::endl;
 			}
-			return DirectedGraph::BuildFromGFA(graph, tryDAG);
 		}
-		else
+		if (loadSeeder)
 		{
-			std::cerr << "Unknown graph type (" << graphFile << ")" << std::endl;
-			std::exit(0);
+			std::cout << "Build seeder from the graph" << std::endl;
+			*seeder = new MummerSeeder { result, graphFile, seederCachePrefix, mxmLength };
 		}
+		return result;
 	}
 	catch (const CommonUtils::InvalidGraphException& e)
 	{
@@ -419,7 +548,7 @@ void alignReads(AlignerParams params)
 	const std::unordered_map<std::string, std::vector<SeedHit>>* seedHitsToThreads = nullptr;
 	std::unordered_map<std::string, std::vector<SeedHit>> seedHits;
 	MummerSeeder* mummerseeder = nullptr;
-	auto alignmentGraph = getGraph(params.graphFile, &mummerseeder, params.mumCount != 0 || params.memCount != 0, params.maxCellsPerSlice == std::numeric_limits<size_t>::max(), params.seederCachePrefix);
+	auto alignmentGraph = getGraph(params.graphFile, &mummerseeder, params.mumCount != 0 || params.memCount != 0, params.maxCellsPerSlice == std::numeric_limits<size_t>::max(), params.localityOrder, params.seederCachePrefix, params.mxmLength, params.graphIndexFile);
 
 	if (params.seedFiles.size() > 0)
 	{
@@ -444,7 +573,15 @@ void alignReads(AlignerParams params)
 		seedHitsToThreads = &seedHits;
 	}
 
-	Seeder seeder { params, seedHitsToThreads, mummerseeder };
+	MinimizerSeeder* minimizerseeder = nullptr;
+	if (params.minimizerLength > 0)
+	{
+		std::cout << "Build minimizer index" << std::endl;
+		minimizerseeder = new MinimizerSeeder { alignmentGraph, params.graphFile, params.minimizerLength, params.minimizerWindowSize, params.seederCachePrefix.size() > 0 ? params.seederCachePrefix + ".minimizers" : "" };
+		std::cout << minimizerseeder->size() << " minimizers in the index" << std::endl;
+	}
+
+	Seeder seeder { params, seedHitsToThreads, mummerseeder, minimizerseeder };
 
 	switch(seeder.mode)
 	{
@@ -457,6 +594,9 @@ void alignReads(AlignerParams params)
 		case Seeder::Mode::Mem:
 			std::cout << "MEM seeds, min length " << seeder.mxmLength << ", max count " << seeder.memCount << std::endl;
 			break;
+		case Seeder::Mode::Minimizer:
+			std::cout << "Minimizer seeds, k " << params.minimizerLength << ", w " << params.minimizerWindowSize << std::endl;
+			break;
 		case Seeder::Mode::None:
 			std::cout << "No seeds, calculate the entire first row. VERY SLOW!" << std::endl;
 			break;
@@ -471,26 +611,43 @@ void alignReads(AlignerParams params)
 
 	assertSetRead("Running alignments", "No seed");
 
-	moodycamel::ConcurrentQueue<std::string*> outputAlns;
-	moodycamel::ConcurrentQueue<std::string*> deallocAlns;
-	moodycamel::ConcurrentQueue<std::shared_ptr<FastQ>> readFastqsQueue;
-	std::atomic<bool> readStreamingFinished { false };
-	std::atomic<bool> allThreadsDone { false };
-	std::atomic<bool> allWriteDone { false };
-	std::vector<moodycamel::ProducerToken> tokens;
-	tokens.reserve(params.numThreads);
-	for (size_t i = 0; i < params.numThreads; i++)
-	{
-		tokens.emplace_back(outputAlns);
-	}
+	//the read limit is rounded to whole batches
+	BlockingQueue<ReadBatch> readFastqsQueue { std::max(params.maxBufferedReads / ReadBatchMaxReads, (size_t)1), params.maxBufferedBp };
+	BlockingQueue<std::string> outputAlns { std::max(params.numThreads, (size_t)1) * OutputBlocksInFlightPerThread };
+	ReorderQueue<std::vector<std::string>> orderedAlns { std::max(params.numThreads, (size_t)1) * ReorderWindowPerThread };
+	BufferPool outputBuffers;
 
+	std::cout << "Buffer at most " << params.maxBufferedReads << " reads / " << params.maxBufferedBp << "bp of input" << std::endl;
 	std::cout << "Align" << std::endl;
 	AlignmentStats stats;
-	std::thread fastqThread { [files=params.fastqFiles, &readFastqsQueue, &readStreamingFinished]() { readFastqs(files, readFastqsQueue, readStreamingFinished); } };
-	std::thread writerThread { [file=params.outputAlignmentFile, &outputAlns, &deallocAlns, &allThreadsDone, &allWriteDone, verboseMode=params.verboseMode]() { consumeVGsAndWrite(file, outputAlns, deallocAlns, allThreadsDone, allWriteDone, verboseMode); } };
+	size_t decompressionThreads = std::max(params.numThreads / 8, (size_t)1);
+	std::thread fastqThread { [files=params.fastqFiles, &readFastqsQueue, decompressionThreads, ordered=params.orderedOutput]() { readFastqs(files, readFastqsQueue, decompressionThreads, ordered); } };
+	std::thread writerThread;
+	if (params.orderedOutput)
+	{
+		writerThread = std::thread { [file=params.outputAlignmentFile, &orderedAlns, &outputBuffers, verboseMode=params.verboseMode]() { consumeOrderedAndWrite(file, orderedAlns, outputBuffers, verboseMode); } };
+	}
+	else
+	{
+		writerThread = std::thread { [file=params.outputAlignmentFile, &outputAlns, &outputBuffers, verboseMode=params.verboseMode]() { consumeVGsAndWrite(file, outputAlns, outputBuffers, verboseMode); } };
+	}
 	for (size_t i = 0; i < params.numThreads; i++)
 	{
-		threads.emplace_back([&alignmentGraph, &readFastqsQueue, &readStreamingFinished, i, seeder, params, &outputAlns, &tokens, &deallocAlns, &stats]() { runComponentMappings(alignmentGraph, readFastqsQueue, readStreamingFinished, i, seeder, params, outputAlns, tokens[i], deallocAlns, stats); });
+		threads.emplace_back([&alignmentGraph, &readFastqsQueue, i, seeder, params, &outputAlns, &orderedAlns, &outputBuffers, &stats]()
+		{
+			AlignmentSink alignmentSink { params.orderedOutput, outputAlns, orderedAlns, outputBuffers };
+			switch(params.wordSize)
+			{
+				case 64:
+					runComponentMappings<uint32_t, uint64_t>(alignmentGraph, readFastqsQueue, i, seeder, params, alignmentSink, stats);
+					break;
+				case 128:
+					runComponentMappings<uint32_t, __uint128_t>(alignmentGraph, readFastqsQueue, i, seeder, params, alignmentSink, stats);
+					break;
+				default:
+					assert(false);
+			}
+		});
 	}
 
 	for (size_t i = 0; i < params.numThreads; i++)
@@ -499,18 +656,14 @@ void alignReads(AlignerParams params)
 	}
 	assertSetRead("Postprocessing", "No seed");
 
-	allThreadsDone = true;
+	outputAlns.close();
+	orderedAlns.close();
 
 	writerThread.join();
 	fastqThread.join();
 
 	if (mummerseeder != nullptr) delete mummerseeder;
-
-	std::string* dealloc;
-	while (deallocAlns.try_dequeue(dealloc))
-	{
-		delete dealloc;
-	}
+	if (minimizerseeder != nullptr) delete minimizerseeder;
 
 	std::cout << "Alignment finished" << std::endl;
 	std::cout << "Input reads: " << stats.reads << " (" << stats.bpInReads << "bp)" << std::endl;
@@ -19,11 +19,21 @@ struct AlignerParams
 	bool verboseMode;
 	bool tryAllSeeds;
 	bool highMemory;
+	bool checkpointSlices;
+	bool joinExtendedSeeds;
 	size_t mxmLength;
 	size_t mumCount;
 	size_t memCount;
+	size_t minimizerLength;
+	size_t minimizerWindowSize;
 	bool outputAllAlns;
 	std::string seederCachePrefix;
+	std::string graphIndexFile;
+	size_t maxBufferedReads;
+	size_t maxBufferedBp;
+	bool orderedOutput;
+	size_t wordSize;
+	bool localityOrder;
 };
 
 void alignReads(AlignerParams params);
@@ -4,6 +4,7 @@
 #include <unistd.h>
 #include <fstream>
 #include <limits>
+#include <stdexcept>
 #include "Aligner.h"
 #include "stream.hpp"
 #include "ThreadReadAssertion.h"
@@ -43,13 +44,19 @@ int main(int argc, char** argv)
 		("verbose", "print progress messages")
 		("all-alignments", "return all alignments instead of the best non-overlapping alignments")
 		("try-all-seeds", "extend all seeds instead of a reasonable looking subset")
+		("join-extended-seeds", "with --try-all-seeds, don't extend a seed which lies on the path of an earlier extension of the same read. faster, but an alignment may take an equal-score alternative path")
+		("max-buffered-reads", boost::program_options::value<size_t>(), "maximum number of input reads buffered in memory while waiting for alignment (int) (default 200 per thread)")
+		("max-buffered-bp", boost::program_options::value<size_t>(), "maximum number of input base pairs buffered in memory while waiting for alignment (int) (default 5000000 per thread)")
+		("ordered-output", "write the alignments in the same order as the input reads. The output does not depend on the number of threads")
+		("graph-index", boost::program_options::value<std::string>(), "store the preprocessed graph to this file for reuse, or load it from the file if it exists")
 	;
 	boost::program_options::options_description seeding("Seeding");
 	seeding.add_options()
-		("seeds-mum-count", boost::program_options::value<size_t>(), "arg longest maximal unique matches fully contained in a node (int) (-1 for all)")
-		("seeds-mem-count", boost::program_options::value<size_t>(), "arg longest maximal exact matches fully contained in a node (int) (-1 for all)")
+		("seeds-mum-count", boost::program_options::value<size_t>(), "arg longest maximal unique matches (int) (-1 for all)")
+		("seeds-mem-count", boost::program_options::value<size_t>(), "arg longest maximal exact matches (int) (-1 for all)")
 		("seeds-mxm-length", boost::program_options::value<size_t>(), "minimum length for maximal unique / exact matches (int)")
-		("seeds-mxm-cache-prefix", boost::program_options::value<std::string>(), "store the mum/mem seeding index to the disk for reuse, or reuse it if it exists (filename prefix)")
+		("seeds-mxm-cache-prefix", boost::program_options::value<std::string>(), "store the mum/mem/minimizer seeding index to the disk for reuse, or reuse it if it exists (filename prefix)")
+		("seeds-minimizer", boost::program_options::value<std::string>(), "minimizer seeds with k-mer length k and window size w (k,w)")
 		("seeds-file,s", boost::program_options::value<std::vector<std::string>>()->multitoken(), "external seeds (.gam)")
 		("seeds-first-full-rows", boost::program_options::value<int>(), "no seeding, instead calculate the first arg rows fully. VERY SLOW except on tiny graphs (int)")
 	;
@@ -59,6 +66,9 @@ int main(int argc, char** argv)
 		("ramp-bandwidth,B", boost::program_options::value<size_t>(), "ramp bandwidth (int)")
 		("tangle-effort,C", boost::program_options::value<size_t>(), "tangle effort limit, higher results in slower but more accurate alignments (int) (-1 for unlimited)")
 		("high-memory", "use slightly less CPU but a lot more memory")
+		("dp-checkpoints", "keep only the scores of every sqrt(n)th row during the extension and recompute the rest for the backtrace. bounds the memory use of very long reads at a cost of some CPU")
+		("word-size", boost::program_options::value<size_t>(), "bit-parallel word size, 64 or 128. 128 processes twice as many read bases per slice (int) (default 64)")
+		("locality-order", "renumber the graph's nodes in breadth-first order so nodes close in the graph are close in memory. faster extension on large graphs whose node ids aren't in graph order")
 	;
 
 	boost::program_options::options_description cmdline_options;
@@ -97,11 +107,21 @@ int main(int argc, char** argv)
 	params.verboseMode = false;
 	params.tryAllSeeds = false;
 	params.highMemory = false;
+	params.checkpointSlices = false;
+	params.joinExtendedSeeds = false;
 	params.mxmLength = 20;
 	params.mumCount = 0;
 	params.memCount = 0;
+	params.minimizerLength = 0;
+	params.minimizerWindowSize = 0;
 	params.seederCachePrefix = "";
+	params.graphIndexFile = "";
 	params.outputAllAlns = false;
+	params.maxBufferedReads = 0;
+	params.maxBufferedBp = 0;
+	params.orderedOutput = false;
+	params.wordSize = 64;
+	params.localityOrder = false;
 
 	if (vm.count("graph")) params.graphFile = vm["graph"].as<std::string>();
 	if (vm.count("reads")) params.fastqFiles = vm["reads"].as<std::vector<std::string>>();
@@ -114,7 +134,24 @@ int main(int argc, char** argv)
 	if (vm.count("seeds-mem-count")) params.memCount = vm["seeds-mem-count"].as<size_t>();
 	if (vm.count("seeds-mum-count")) params.mumCount = vm["seeds-mum-count"].as<size_t>();
 	if (vm.count("seeds-mxm-cache-prefix")) params.seederCachePrefix = vm["seeds-mxm-cache-prefix"].as<std::string>();
+	if (vm.count("graph-index")) params.graphIndexFile = vm["graph-index"].as<std::string>();
 	if (vm.count("seeds-first-full-rows")) params.dynamicRowStart = vm["seeds-first-full-rows"].as<int>();
+	bool minimizerParamError = false;
+	if (vm.count("seeds-minimizer"))
+	{
+		std::string minimizerParams = vm["seeds-minimizer"].as<std::string>();
+		size_t comma = minimizerParams.find(',');
+		try
+		{
+			if (comma == std::string::npos) throw std::invalid_argument { minimizerParams };
+			params.minimizerLength = std::stoul(minimizerParams.substr(0, comma));
+			params.minimizerWindowSize = std::stoul(minimizerParams.substr(comma + 1));
+		}
+		catch (const std::logic_error& e)
+		{
+			minimizerParamError = true;
+		}
+	}
 
 	if (vm.count("ramp-bandwidth")) params.rampBandwidth = vm["ramp-bandwidth"].as<size_t>();
 	if (vm.count("tangle-effort")) params.maxCellsPerSlice = vm["tangle-effort"].as<size_t>();
@@ -126,6 +163,13 @@ int main(int argc, char** argv)
 	if (vm.count("verbose")) params.verboseMode = true;
 	if (vm.count("try-all-seeds")) params.tryAllSeeds = true;
 	if (vm.count("high-memory")) params.highMemory = true;
+	if (vm.count("dp-checkpoints")) params.checkpointSlices = true;
+	if (vm.count("join-extended-seeds")) params.joinExtendedSeeds = true;
+	if (vm.count("max-buffered-reads")) params.maxBufferedReads = vm["max-buffered-reads"].as<size_t>();
+	if (vm.count("max-buffered-bp")) params.maxBufferedBp = vm["max-buffered-bp"].as<size_t>();
+	if (vm.count("ordered-output")) params.orderedOutput = true;
+	if (vm.count("word-size")) params.wordSize = vm["word-size"].as<size_t>();
+	if (vm.count("locality-order")) params.localityOrder = true;
 
 	bool paramError = false;
 
@@ -154,6 +198,18 @@ int main(int argc, char** argv)
 		std::cerr << "number of threads must be >= 1" << std::endl;
 		paramError = true;
 	}
+	if (vm.count("max-buffered-reads") && params.maxBufferedReads < 1)
+	{
+		std::cerr << "max-buffered-reads must be >= 1" << std::endl;
+		paramError = true;
+	}
+	if (vm.count("max-buffered-bp") && params.maxBufferedBp < 1)
+	{
+		std::cerr << "max-buffered-bp must be >= 1" << std::endl;
+		paramError = true;
+	}
+	if (!vm.count("max-buffered-reads")) params.maxBufferedReads = params.numThreads * 200;
+	if (!vm.count("max-buffered-bp")) params.maxBufferedBp = params.numThreads * 5000000;
 	if (params.initialBandwidth == 0 && params.rampBandwidth == 0 && params.maxCellsPerSlice == std::numeric_limits<decltype(params.maxCellsPerSlice)>::max())
 	{
 		//default extension parameters
@@ -166,17 +222,27 @@ int main(int argc, char** argv)
 		std::cerr << "default bandwidth must be >= 1" << std::endl;
 		paramError = true;
 	}
+	if (params.wordSize != 64 && params.wordSize != 128)
+	{
+		std::cerr << "word size must be 64 or 128" << std::endl;
+		paramError = true;
+	}
 	if (params.rampBandwidth != 0 && params.rampBandwidth <= params.initialBandwidth)
 	{
 		std::cerr << "ramp bandwidth must be higher than default bandwidth" << std::endl;
 		paramError = true;
 	}
+	if (minimizerParamError || (vm.count("seeds-minimizer") && (params.minimizerLength < 1 || params.minimizerLength > 31 || params.minimizerWindowSize < 1)))
+	{
+		std::cerr << "seeds-minimizer must be k,w with 1 <= k <= 31 and w >= 1" << std::endl;
+		paramError = true;
+	}
 	if (params.mxmLength < 2)
 	{
 		std::cerr << "mum/mem minimum length must be >= 2" << std::endl;
 		paramError = true;
 	}
-	int pickedSeedingMethods = ((params.dynamicRowStart != 0) ? 1 : 0) + ((params.seedFiles.size() > 0) ? 1 : 0) + ((params.mumCount != 0) ? 1 : 0) + ((params.memCount != 0) ? 1 : 0);
+	int pickedSeedingMethods = ((params.dynamicRowStart != 0) ? 1 : 0) + ((params.seedFiles.size() > 0) ? 1 : 0) + ((params.mumCount != 0) ? 1 : 0) + ((params.memCount != 0) ? 1 : 0) + ((params.minimizerLength != 0) ? 1 : 0);
 	if (pickedSeedingMethods == 0)
 	{
 		//use MUMs as the default seeding method
@@ -10,8 +10,6 @@ const double correctStddev = 0.0955;
 const double wrongMean = 0.5;
 const double wrondStddev = 0.0291;
 
-const int wordSize = 64;
-
 const double falseToCorrectTransitionLogProbability = log(0.00001); //10^-5. arbitrary.
 const double falseToFalseTransitionLogProbability = log(1.0 - 0.00001);
 const double correctToFalseTransitionLogProbability = log(0.0000000001); //10^-10. arbitrary.
@@ -36,7 +34,8 @@ void normalize(std::vector<double>& logs)
 	}
 }
 
-std::vector<double> getCorrectLogOdds()
+//the mismatch distribution of a slice of wordSize rows
+std::vector<double> getCorrectLogOdds(int wordSize)
 {
 	std::vector<double> result;
 	for (int i = 0; i <= wordSize/2; i++)
@@ -51,7 +50,7 @@ std::vector<double> getCorrectLogOdds()
 	return result;
 }
 
-std::vector<double> getWrongLogOdds()
+std::vector<double> getWrongLogOdds(int wordSize)
 {
 	std::vector<double> result;
 	for (int i = 0; i <= wordSize/2; i++)
@@ -66,8 +65,9 @@ std::vector<double> getWrongLogOdds()
 	return result;
 }
 
-const std::vector<double> precomputedCorrectLogOdds = getCorrectLogOdds();
-const std::vector<double> precomputedWrongLogOdds = getWrongLogOdds();
+//for slices of 64 and 128 rows
+const std::vector<double> precomputedCorrectLogOdds[2] { getCorrectLogOdds(64), getCorrectLogOdds(128) };
+const std::vector<double> precomputedWrongLogOdds[2] { getWrongLogOdds(64), getWrongLogOdds(128) };
 
 AlignmentCorrectnessEstimationState::AlignmentCorrectnessEstimationState() :
 correctLogOdds(log(0.8)), //80% arbitrarily
@@ -104,24 +104,26 @@ double AlignmentCorrectnessEstimationState::FalseLogOdds() const
 
 AlignmentCorrectnessEstimationState AlignmentCorrectnessEstimationState::NextState(int mismatches, int rowSize) const
 {
-	assert(rowSize == 64);
+	assert(rowSize == 64 || rowSize == 128);
 	// assert(rowSize == 64 || rowSize == 1);
 	assert(mismatches >= 0);
+	const std::vector<double>& correctLogOddsForRow = precomputedCorrectLogOdds[rowSize == 64 ? 0 : 1];
+	const std::vector<double>& wrongLogOddsForRow = precomputedWrongLogOdds[rowSize == 64 ? 0 : 1];
 	AlignmentCorrectnessEstimationState result;
 	result.correctFromCorrectTrace = correctLogOdds + correctToCorrectTransitionLogProbability >= falseLogOdds + falseToCorrectTransitionLogProbability;
 	result.falseFromCorrectTrace = correctLogOdds + correctToFalseTransitionLogProbability >= falseLogOdds + falseToFalseTransitionLogProbability;
 	double newCorrectProbability = std::max(correctLogOdds + correctToCorrectTransitionLogProbability, falseLogOdds + falseToCorrectTransitionLogProbability);
 	double newFalseProbability = std::max(correctLogOdds + correctToFalseTransitionLogProbability, falseLogOdds + falseToFalseTransitionLogProbability);
-	assert(precomputedCorrectLogOdds.size() == precomputedWrongLogOdds.size());
-	if ((size_t)mismatches < precomputedCorrectLogOdds.size())
+	assert(correctLogOddsForRow.size() == wrongLogOddsForRow.size());
+	if ((size_t)mismatches < correctLogOddsForRow.size())
 	{
-		newCorrectProbability += precomputedCorrectLogOdds[(size_t)mismatches];
-		newFalseProbability += precomputedWrongLogOdds[(size_t)mismatches];
+		newCorrectProbability += correctLogOddsForRow[(size_t)mismatches];
+		newFalseProbability += wrongLogOddsForRow[(size_t)mismatches];
 	}
 	else
 	{
-		newCorrectProbability += precomputedCorrectLogOdds.back();
-		newFalseProbability += precomputedWrongLogOdds.back();
+		newCorrectProbability += correctLogOddsForRow.back();
+		newFalseProbability += wrongLogOddsForRow.back();
 	}
 	result.correctLogOdds = newCorrectProbability;
 	result.falseLogOdds = newFalseProbability;
@@ -6,13 +6,101 @@
 #include "CommonUtils.h"
 #include "ThreadReadAssertion.h"
 
+//the graph index format, bump when the contents change
+const std::string GraphIndexType = "graph";
+const uint64_t GraphIndexVersion = 1;
+
+AdjacencyList::AdjacencyList() :
+offsets(),
+targets()
+{
+	offsets.assign(std::vector<uint64_t>(1, 0));
+}
+
+AdjacencyList::AdjacencyList(size_t numNodes, const std::vector<std::pair<uint32_t, uint32_t>>& edges) :
+offsets(),
+targets()
+{
+	assert(numNodes <= std::numeric_limits<uint32_t>::max());
+	std::vector<uint64_t> newOffsets(numNodes + 1, 0);
+	std::vector<uint32_t> newTargets;
+	for (auto edge : edges)
+	{
+		assert(edge.first < numNodes);
+		newOffsets[edge.first + 1] += 1;
+	}
+	for (size_t i = 1; i <= numNodes; i++)
+	{
+		newOffsets[i] += newOffsets[i-1];
+	}
+	newTargets.resize(edges.size());
+	std::vector<size_t> insertPos { newOffsets.begin(), newOffsets.end() - 1 };
+	for (auto edge : edges)
+	{
+		assert(edge.second < numNodes);
+		newTargets[insertPos[edge.first]++] = edge.second;
+	}
+	//don't add double edges
+	size_t write = 0;
+	for (size_t i = 0; i < numNodes; i++)
+	{
+		size_t start = newOffsets[i];
+		size_t end = newOffsets[i+1];
+		newOffsets[i] = write;
+		for (size_t j = start; j < end; j++)
+		{
+			if (std::find(newTargets.begin() + newOffsets[i], newTargets.begin() + write, newTargets[j]) == newTargets.begin() + write)
+			{
+				newTargets[write] = newTargets[j];
+				write++;
+			}
+		}
+	}
+	newOffsets[numNodes] = write;
+	newTargets.resize(write);
+	newTargets.shrink_to_fit();
+	offsets.assign(std::move(newOffsets));
+	targets.assign(std::move(newTargets));
+}
+
+size_t AdjacencyList::size() const
+{
+	return offsets.size() - 1;
+}
+
+size_t AdjacencyList::numEdges() const
+{
+	return targets.size();
+}
+
+void AdjacencyList::saveTo(IndexFileWriter& file) const
+{
+	file.writeArray(offsets.data(), offsets.size());
+	file.writeArray(targets.data(), targets.size());
+}
+
+bool AdjacencyList::loadFrom(IndexFileReader& file)
+{
+	if (!file.readArray(offsets) || !file.readArray(targets)) return false;
+	return offsets.size() >= 1 && offsets.back() == targets.size();
+}
+
 AlignmentGraph::AlignmentGraph() :
+building(),
 nodeLength(),
-nodeLookup(),
+nodeOffset(),
 nodeIDs(),
 inNeighbors(),
+outNeighbors(),
 nodeSequences(),
 ambiguousNodeSequences(),
+componentNumber(),
+originalNodeIDs(),
+originalNodeSizes(),
+originalNodeSplitStart(),
+originalNodeSplitNodes(),
+originalNodeNameStart(),
+originalNodeNames(),
 firstAmbiguous(std::numeric_limits<size_t>::max()),
 finalized(false)
 {
@@ -20,15 +108,19 @@ finalized(false)
 
 void AlignmentGraph::ReserveNodes(size_t numNodes, size_t numSplitNodes)
 {
-	nodeSequences.reserve(numSplitNodes);
-	ambiguousNodeSequences.reserve(numSplitNodes);
-	nodeLookup.reserve(numNodes);
-	nodeIDs.reserve(numSplitNodes);
-	nodeLength.reserve(numSplitNodes);
-	inNeighbors.reserve(numSplitNodes);
-	outNeighbors.reserve(numSplitNodes);
-	reverse.reserve(numSplitNodes);
-	nodeOffset.reserve(numSplitNodes);
+	building.nodeSequences.reserve(numSplitNodes);
+	building.ambiguousNodeSequences.reserve(numSplitNodes);
+	building.originalNodeIndex.reserve(numNodes);
+	building.originalNodeIDs.reserve(numNodes);
+	building.originalNodeSizes.reserve(numNodes);
+	building.originalNodeSplitStart.reserve(numNodes + 1);
+	building.originalNodeNameStart.reserve(numNodes + 1);
+	building.originalNodeSplitNodes.reserve(numSplitNodes);
+	building.nodeIDs.reserve(numSplitNodes);
+	building.nodeLength.reserve(numSplitNodes);
+	building.edges.reserve(numSplitNodes);
+	building.reverse.reserve(numSplitNodes);
+	building.nodeOffset.reserve(numSplitNodes);
 }
 
 void AlignmentGraph::AddNode(int nodeId, const std::string& sequence, const std::string& name, bool reverseNode, const std::vector<size_t>& breakpoints)
@@ -37,9 +129,13 @@ void AlignmentGraph::AddNode(int nodeId, const std::string& sequence, const std:
 	assert(!finalized);
 	//subgraph extraction might produce different subgraphs with common nodes
 	//don't add duplicate nodes
-	if (nodeLookup.count(nodeId) != 0) return;
-	originalNodeSize[nodeId] = sequence.size();
-	originalNodeName[nodeId] = name;
+	if (building.originalNodeIndex.count(nodeId) != 0) return;
+	assert(building.originalNodeIDs.size() < std::numeric_limits<uint32_t>::max());
+	building.originalNodeIndex[nodeId] = building.originalNodeIDs.size();
+	building.originalNodeIDs.push_back(nodeId);
+	building.originalNodeSizes.push_back(sequence.size());
+	building.originalNodeNames.insert(building.originalNodeNames.end(), name.begin(), name.end());
+	building.originalNodeNameStart.push_back(building.originalNodeNames.size());
 	assert(breakpoints.size() >= 2);
 	assert(breakpoints[0] == 0);
 	assert(breakpoints.back() == sequence.size());
@@ -55,17 +151,15 @@ void AlignmentGraph::AddNode(int nodeId, const std::string& sequence, const std:
 			AddNode(nodeId, offset, sequence.substr(offset, size), reverseNode);
 			if (offset > 0)
 			{
-				assert(outNeighbors.size() >= 2);
-				assert(outNeighbors.size() == inNeighbors.size());
-				assert(nodeIDs.size() == outNeighbors.size());
-				assert(nodeOffset.size() == outNeighbors.size());
-				assert(nodeIDs[outNeighbors.size()-2] == nodeIDs[outNeighbors.size()-1]);
-				assert(nodeOffset[outNeighbors.size()-2] + nodeLength[outNeighbors.size()-2] == nodeOffset[outNeighbors.size()-1]);
-				outNeighbors[outNeighbors.size()-2].push_back(outNeighbors.size()-1);
-				inNeighbors[inNeighbors.size()-1].push_back(inNeighbors.size()-2);
+				assert(building.nodeIDs.size() >= 2);
+				assert(building.nodeOffset.size() == building.nodeIDs.size());
+				assert(building.nodeIDs[building.nodeIDs.size()-2] == building.nodeIDs[building.nodeIDs.size()-1]);
+				assert(building.nodeOffset[building.nodeIDs.size()-2] + building.nodeLength[building.nodeIDs.size()-2] == building.nodeOffset[building.nodeIDs.size()-1]);
+				building.edges.emplace_back(building.nodeIDs.size()-2, building.nodeIDs.size()-1);
 			}
 		}
 	}
+	building.originalNodeSplitStart.push_back(building.originalNodeSplitNodes.size());
 }
 
 void AlignmentGraph::AddNode(int nodeId, int offset, const std::string& sequence, bool reverseNode)
@@ -73,14 +167,14 @@ void AlignmentGraph::AddNode(int nodeId, int offset, const std::string& sequence
 	assert(firstAmbiguous == std::numeric_limits<size_t>::max());
 	assert(!finalized);
 	assert(sequence.size() <= SPLIT_NODE_SIZE);
+	//node indices are 32-bit in the aligner and the max value is reserved as a "no node" marker
+	if (building.nodeLength.size() >= std::numeric_limits<uint32_t>::max() - 1) throw CommonUtils::InvalidGraphException { "Graph has too many nodes after splitting, the maximum is 2^32-2" };
 
-	nodeLookup[nodeId].push_back(nodeLength.size());
-	nodeLength.push_back(sequence.size());
-	nodeIDs.push_back(nodeId);
-	inNeighbors.emplace_back();
-	outNeighbors.emplace_back();
-	reverse.push_back(reverseNode);
-	nodeOffset.push_back(offset);
+	building.originalNodeSplitNodes.push_back(building.nodeLength.size());
+	building.nodeLength.push_back(sequence.size());
+	building.nodeIDs.push_back(nodeId);
+	building.reverse.push_back(reverseNode);
+	building.nodeOffset.push_back(offset);
 	NodeChunkSequence normalSeq;
 	for (size_t i = 0; i < CHUNKS_IN_NODE; i++)
 	{
@@ -198,80 +292,89 @@ void AlignmentGraph::AddNode(int nodeId, int offset, const std::string& sequence
 				assert(false);
 		}
 	}
-	ambiguousNodes.push_back(ambiguous);
+	building.ambiguousNodes.push_back(ambiguous);
 	if (ambiguous)
 	{
-		ambiguousNodeSequences.emplace_back(ambiguousSeq);
+		building.ambiguousNodeSequences.emplace_back(ambiguousSeq);
 	}
 	else
 	{
-		nodeSequences.emplace_back(normalSeq);
+		building.nodeSequences.emplace_back(normalSeq);
 	}
-	assert(nodeIDs.size() == nodeLength.size());
-	assert(nodeLength.size() == inNeighbors.size());
-	assert(inNeighbors.size() == outNeighbors.size());
+	assert(building.nodeIDs.size() == building.nodeLength.size());
 }
 
 void AlignmentGraph::AddEdgeNodeId(int node_id_from, int node_id_to, size_t startOffset)
 {
 	assert(firstAmbiguous == std::numeric_limits<size_t>::max());
 	assert(!finalized);
-	assert(nodeLookup.count(node_id_from) > 0);
-	assert(nodeLookup.count(node_id_to) > 0);
-	size_t from = nodeLookup.at(node_id_from).back();
+	assert(building.originalNodeIndex.count(node_id_from) > 0);
+	assert(building.originalNodeIndex.count(node_id_to) > 0);
+	//the nodes aren't renumbered before Finalize, so the split nodes of an original node are consecutive
+	size_t fromIndex = building.originalNodeIndex.at(node_id_from);
+	assert(building.originalNodeSplitStart[fromIndex + 1] > building.originalNodeSplitStart[fromIndex]);
+	size_t from = building.originalNodeSplitNodes[building.originalNodeSplitStart[fromIndex + 1] - 1];
 	size_t to = std::numeric_limits<size_t>::max();
-	assert(nodeOffset[from] + nodeLength[from] == originalNodeSize[node_id_from]);
-	auto looked = nodeLookup[node_id_to];
-	for (auto node : nodeLookup[node_id_to])
+	assert(building.nodeOffset[from] + building.nodeLength[from] == building.originalNodeSizes[fromIndex]);
+	size_t toIndex = building.originalNodeIndex.at(node_id_to);
+	for (size_t i = building.originalNodeSplitStart[toIndex]; i < building.originalNodeSplitStart[toIndex + 1]; i++)
 	{
-		if (nodeOffset[node] == startOffset)
+		size_t node = building.originalNodeSplitNodes[i];
+		if (building.nodeOffset[node] == startOffset)
 		{
 			to = node;
 		}
 	}
 	assert(to != std::numeric_limits<size_t>::max());
-	//don't add double edges
-	if (std::find(inNeighbors[to].begin(), inNeighbors[to].end(), from) == inNeighbors[to].end()) inNeighbors[to].push_back(from);
-	if (std::find(outNeighbors[from].begin(), outNeighbors[from].end(), to) == outNeighbors[from].end()) outNeighbors[from].push_back(to);
+	//double edges are removed in Finalize
+	building.edges.emplace_back(from, to);
 }
 
-void AlignmentGraph::Finalize(int wordSize, bool doComponents)
+void AlignmentGraph::Finalize(int wordSize, bool doComponents, bool localityOrder)
 {
-	assert(nodeSequences.size() + ambiguousNodeSequences.size() == nodeLength.size());
-	assert(inNeighbors.size() == nodeLength.size());
-	assert(outNeighbors.size() == nodeLength.size());
-	assert(reverse.size() == nodeLength.size());
-	assert(nodeIDs.size() == nodeLength.size());
+	assert(building.nodeSequences.size() + building.ambiguousNodeSequences.size() == building.nodeLength.size());
+	assert(building.reverse.size() == building.nodeLength.size());
+	assert(building.nodeIDs.size() == building.nodeLength.size());
 	RenumberAmbiguousToEnd();
-	ambiguousNodes.clear();
-	std::cout << nodeLookup.size() << " original nodes" << std::endl;
+	if (localityOrder)
+	{
+		std::cout << "renumber nodes in breadth-first order" << std::endl;
+		RenumberForLocality();
+	}
+	outNeighbors = AdjacencyList { building.nodeLength.size(), building.edges };
+	for (auto& edge : building.edges)
+	{
+		std::swap(edge.first, edge.second);
+	}
+	inNeighbors = AdjacencyList { building.nodeLength.size(), building.edges };
+	buildOriginalNodeTables();
+	building.nodeLength.shrink_to_fit();
+	building.nodeOffset.shrink_to_fit();
+	building.nodeIDs.shrink_to_fit();
+	building.nodeSequences.shrink_to_fit();
+	building.ambiguousNodeSequences.shrink_to_fit();
+	nodeLength.assign(std::move(building.nodeLength));
+	nodeOffset.assign(std::move(building.nodeOffset));
+	nodeIDs.assign(std::move(building.nodeIDs));
+	nodeSequences.assign(std::move(building.nodeSequences));
+	ambiguousNodeSequences.assign(std::move(building.ambiguousNodeSequences));
+	building = BuildStorage {};
+	std::cout << originalNodeIDs.size() << " original nodes" << std::endl;
 	std::cout << nodeLength.size() << " split nodes" << std::endl;
 	std::cout << ambiguousNodeSequences.size() << " ambiguous split nodes" << std::endl;
 	finalized = true;
 	int specialNodes = 0;
-	size_t edges = 0;
 	for (size_t i = 0; i < inNeighbors.size(); i++)
 	{
-		inNeighbors[i].shrink_to_fit();
-		outNeighbors[i].shrink_to_fit();
 		if (inNeighbors[i].size() >= 2) specialNodes++;
-		edges += inNeighbors[i].size();
 	}
-	std::cout << edges << " edges" << std::endl;
+	std::cout << inNeighbors.numEdges() << " edges" << std::endl;
 	std::cout << specialNodes << " nodes with in-degree >= 2" << std::endl;
 	assert(nodeSequences.size() + ambiguousNodeSequences.size() == nodeLength.size());
 	assert(inNeighbors.size() == nodeLength.size());
 	assert(outNeighbors.size() == nodeLength.size());
-	assert(reverse.size() == nodeLength.size());
 	assert(nodeIDs.size() == nodeLength.size());
 	assert(nodeOffset.size() == nodeLength.size());
-	nodeLength.shrink_to_fit();
-	nodeIDs.shrink_to_fit();
-	inNeighbors.shrink_to_fit();
-	outNeighbors.shrink_to_fit();
-	reverse.shrink_to_fit();
-	nodeSequences.shrink_to_fit();
-	ambiguousNodeSequences.shrink_to_fit();
 	if (doComponents)
 	{
 		std::cout << "use component ordering" << std::endl;
@@ -365,13 +468,16 @@ public:
 	size_t distance;
 };
 
+//the split nodes of an original node are in offset order, so the node containing the offset is found with a binary search
 size_t AlignmentGraph::GetUnitigNode(int nodeId, size_t offset) const
 {
-	auto nodes = nodeLookup.at(nodeId);
-	size_t index = 0;
-	while (index < nodes.size() && (nodeOffset[nodes[index]] > offset || nodeOffset[nodes[index]] + NodeLength(nodes[index]) <= offset)) index++;
-	assert(index != nodes.size());
-	size_t result = nodes[index];
+	size_t original = originalNodeIndex(nodeId);
+	assert(offset < originalNodeSizes[original]);
+	auto start = originalNodeSplitNodes.begin() + originalNodeSplitStart[original];
+	auto end = originalNodeSplitNodes.begin() + originalNodeSplitStart[original+1];
+	auto found = std::upper_bound(start, end, offset, [this](size_t offset, uint32_t node) { return offset < nodeOffset[node]; });
+	assert(found != start);
+	size_t result = *(found - 1);
 	assert(nodeOffset[result] <= offset);
 	assert(nodeOffset[result] + NodeLength(result) > offset);
 	return result;
@@ -379,9 +485,7 @@ size_t AlignmentGraph::GetUnitigNode(int nodeId, size_t offset) const
 
 std::pair<int, size_t> AlignmentGraph::GetReversePosition(int nodeId, size_t offset) const
 {
-	assert(nodeLookup.count(nodeId) == 1);
-	auto nodes = nodeLookup.at(nodeId);
-	size_t originalSize = originalNodeSize.at(nodeId);
+	size_t originalSize = OriginalNodeSize(nodeId);
 	assert(offset < originalSize);
 	size_t newOffset = originalSize - offset - 1;
 	assert(newOffset < originalSize);
@@ -416,14 +520,134 @@ bool AlignmentGraph::MatrixPosition::operator!=(const AlignmentGraph::MatrixPosi
 
 std::string AlignmentGraph::OriginalNodeName(int nodeId) const
 {
-	auto found = originalNodeName.find(nodeId);
-	if (found == originalNodeName.end()) return "";
-	return found->second;
+	auto found = std::lower_bound(originalNodeIDs.begin(), originalNodeIDs.end(), nodeId);
+	if (found == originalNodeIDs.end() || *found != nodeId) return "";
+	size_t index = found - originalNodeIDs.begin();
+	return std::string { originalNodeNames.data() + originalNodeNameStart[index], originalNodeNames.data() + originalNodeNameStart[index+1] };
+}
+
+size_t AlignmentGraph::OriginalNodeSize(int nodeId) const
+{
+	return originalNodeSizes[originalNodeIndex(nodeId)];
+}
+
+size_t AlignmentGraph::originalNodeIndex(int nodeId) const
+{
+	auto found = std::lower_bound(originalNodeIDs.begin(), originalNodeIDs.end(), nodeId);
+	assert(found != originalNodeIDs.end() && *found == nodeId);
+	return found - originalNodeIDs.begin();
+}
+
+//sorts the original nodes by the node id
+void AlignmentGraph::buildOriginalNodeTables()
+{
+	size_t numOriginal = building.originalNodeIDs.size();
+	std::unordered_map<int, uint32_t>().swap(building.originalNodeIndex);
+	std::vector<uint32_t> order;
+	order.reserve(numOriginal);
+	for (size_t i = 0; i < numOriginal; i++)
+	{
+		order.push_back(i);
+	}
+	std::sort(order.begin(), order.end(), [this](uint32_t left, uint32_t right) { return building.originalNodeIDs[left] < building.originalNodeIDs[right]; });
+	std::vector<int> ids;
+	std::vector<uint64_t> sizes;
+	std::vector<uint64_t> splitStart;
+	std::vector<uint32_t> splitNodes;
+	std::vector<uint64_t> nameStart;
+	std::vector<char> names;
+	ids.reserve(numOriginal);
+	sizes.reserve(numOriginal);
+	splitStart.reserve(numOriginal + 1);
+	splitNodes.reserve(building.originalNodeSplitNodes.size());
+	nameStart.reserve(numOriginal + 1);
+	names.reserve(building.originalNodeNames.size());
+	for (auto i : order)
+	{
+		ids.push_back(building.originalNodeIDs[i]);
+		sizes.push_back(building.originalNodeSizes[i]);
+		splitStart.push_back(splitNodes.size());
+		splitNodes.insert(splitNodes.end(), building.originalNodeSplitNodes.begin() + building.originalNodeSplitStart[i], building.originalNodeSplitNodes.begin() + building.originalNodeSplitStart[i+1]);
+		nameStart.push_back(names.size());
+		names.insert(names.end(), building.originalNodeNames.begin() + building.originalNodeNameStart[i], building.originalNodeNames.begin() + building.originalNodeNameStart[i+1]);
+	}
+	splitStart.push_back(splitNodes.size());
+	nameStart.push_back(names.size());
+	originalNodeIDs.assign(std::move(ids));
+	originalNodeSizes.assign(std::move(sizes));
+	originalNodeSplitStart.assign(std::move(splitStart));
+	originalNodeSplitNodes.assign(std::move(splitNodes));
+	originalNodeNameStart.assign(std::move(nameStart));
+	originalNodeNames.assign(std::move(names));
+}
+
+bool AlignmentGraph::SaveTo(const std::string& indexFile, const GraphFingerprint& graph, bool doComponents, bool localityOrder) const
+{
+	assert(finalized);
+	IndexFileWriter file { indexFile, GraphIndexType, GraphIndexVersion, graph };
+	file.writeValue(doComponents ? 1 : 0);
+	file.writeValue(localityOrder ? 1 : 0);
+	file.writeValue(firstAmbiguous);
+	file.writeArray(nodeLength.data(), nodeLength.size());
+	file.writeArray(nodeOffset.data(), nodeOffset.size());
+	file.writeArray(nodeIDs.data(), nodeIDs.size());
+	file.writeArray(nodeSequences.data(), nodeSequences.size());
+	file.writeArray(ambiguousNodeSequences.data(), ambiguousNodeSequences.size());
+	file.writeArray(componentNumber.data(), componentNumber.size());
+	inNeighbors.saveTo(file);
+	outNeighbors.saveTo(file);
+	file.writeArray(originalNodeIDs.data(), originalNodeIDs.size());
+	file.writeArray(originalNodeSizes.data(), originalNodeSizes.size());
+	file.writeArray(originalNodeSplitStart.data(), originalNodeSplitStart.size());
+	file.writeArray(originalNodeSplitNodes.data(), originalNodeSplitNodes.size());
+	file.writeArray(originalNodeNameStart.data(), originalNodeNameStart.size());
+	file.writeArray(originalNodeNames.data(), originalNodeNames.size());
+	return file.finish();
+}
+
+//returns false if there is no index, or it is from an older version, was built from a different graph or with different options, and the graph has to be built
+//the graph can't be used after a failed load
+//the arrays are used in place from the read-only mapping, so concurrent aligners share one copy of the graph through the page cache
+bool AlignmentGraph::LoadFrom(const std::string& indexFile, const GraphFingerprint& graph, bool doComponents, bool localityOrder)
+{
+	assert(!finalized);
+	IndexFileReader file { indexFile, GraphIndexType, GraphIndexVersion, graph };
+	if (!file.valid()) return false;
+	uint64_t indexDoComponents, indexLocalityOrder, indexFirstAmbiguous;
+	if (!file.readValue(indexDoComponents) || !file.readValue(indexLocalityOrder) || !file.readValue(indexFirstAmbiguous)) return false;
+	if (indexDoComponents != (doComponents ? 1 : 0) || indexLocalityOrder != (localityOrder ? 1 : 0)) return false;
+	if (!file.readArray(nodeLength)) return false;
+	if (!file.readArray(nodeOffset)) return false;
+	if (!file.readArray(nodeIDs)) return false;
+	if (!file.readArray(nodeSequences)) return false;
+	if (!file.readArray(ambiguousNodeSequences)) return false;
+	if (!file.readArray(componentNumber)) return false;
+	if (!inNeighbors.loadFrom(file)) return false;
+	if (!outNeighbors.loadFrom(file)) return false;
+	if (!file.readArray(originalNodeIDs)) return false;
+	if (!file.readArray(originalNodeSizes)) return false;
+	if (!file.readArray(originalNodeSplitStart)) return false;
+	if (!file.readArray(originalNodeSplitNodes)) return false;
+	if (!file.readArray(originalNodeNameStart)) return false;
+	if (!file.readArray(originalNodeNames)) return false;
+	firstAmbiguous = indexFirstAmbiguous;
+	size_t numNodes = nodeLength.size();
+	if (nodeOffset.size() != numNodes || nodeIDs.size() != numNodes || inNeighbors.size() != numNodes || outNeighbors.size() != numNodes) return false;
+	if (firstAmbiguous != nodeSequences.size() || nodeSequences.size() + ambiguousNodeSequences.size() != numNodes) return false;
+	if (doComponents != (componentNumber.size() == numNodes)) return false;
+	if (originalNodeSizes.size() != originalNodeIDs.size() || originalNodeSplitStart.size() != originalNodeIDs.size() + 1 || originalNodeNameStart.size() != originalNodeIDs.size() + 1) return false;
+	if (originalNodeSplitStart.back() != originalNodeSplitNodes.size() || originalNodeNameStart.back() != originalNodeNames.size()) return false;
+	finalized = true;
+	std::cout << originalNodeIDs.size() << " original nodes" << std::endl;
+	std::cout << nodeLength.size() << " split nodes" << std::endl;
+	std::cout << ambiguousNodeSequences.size() << " ambiguous split nodes" << std::endl;
+	std::cout << inNeighbors.numEdges() << " edges" << std::endl;
+	return true;
 }
 
-std::vector<size_t> renumber(const std::vector<size_t>& vec, const std::vector<size_t>& renumbering)
+std::vector<uint32_t> renumber(const std::vector<uint32_t>& vec, const std::vector<size_t>& renumbering)
 {
-	std::vector<size_t> result;
+	std::vector<uint32_t> result;
 	result.reserve(vec.size());
 	for (size_t i = 0; i < vec.size(); i++)
 	{
@@ -448,88 +672,148 @@ std::vector<T> reorder(const std::vector<T>& vec, const std::vector<size_t>& ren
 
 void AlignmentGraph::RenumberAmbiguousToEnd()
 {
-	assert(nodeSequences.size() + ambiguousNodeSequences.size() == nodeLength.size());
-	assert(inNeighbors.size() == nodeLength.size());
-	assert(outNeighbors.size() == nodeLength.size());
-	assert(reverse.size() == nodeLength.size());
-	assert(nodeIDs.size() == nodeLength.size());
-	assert(ambiguousNodes.size() == nodeLength.size());
+	assert(building.nodeSequences.size() + building.ambiguousNodeSequences.size() == building.nodeLength.size());
+	assert(building.reverse.size() == building.nodeLength.size());
+	assert(building.nodeIDs.size() == building.nodeLength.size());
+	assert(building.ambiguousNodes.size() == building.nodeLength.size());
 	assert(firstAmbiguous == std::numeric_limits<size_t>::max());
 	assert(!finalized);
 	std::vector<size_t> renumbering;
-	renumbering.reserve(ambiguousNodes.size());
+	renumbering.reserve(building.ambiguousNodes.size());
 	size_t nonAmbiguousCount = 0;
 	size_t ambiguousCount = 0;
-	for (size_t i = 0; i < ambiguousNodes.size(); i++)
+	for (size_t i = 0; i < building.ambiguousNodes.size(); i++)
 	{
-		if (!ambiguousNodes[i])
+		if (!building.ambiguousNodes[i])
 		{
 			renumbering.push_back(nonAmbiguousCount);
 			nonAmbiguousCount++;
 		}
 		else
 		{
-			assert(ambiguousCount < ambiguousNodes.size());
-			assert(ambiguousNodes.size()-1-ambiguousCount > nonAmbiguousCount);
-			renumbering.push_back(ambiguousNodes.size()-1-ambiguousCount);
+			assert(ambiguousCount < building.ambiguousNodes.size());
+			assert(building.ambiguousNodes.size()-1-ambiguousCount > nonAmbiguousCount);
+			renumbering.push_back(building.ambiguousNodes.size()-1-ambiguousCount);
 			ambiguousCount++;
 		}
 	}
-	assert(renumbering.size() == ambiguousNodes.size());
-	assert(nonAmbiguousCount + ambiguousCount == ambiguousNodes.size());
-	assert(ambiguousCount == ambiguousNodeSequences.size());
-	assert(nonAmbiguousCount == nodeSequences.size());
+	assert(renumbering.size() == building.ambiguousNodes.size());
+	assert(nonAmbiguousCount + ambiguousCount == building.ambiguousNodes.size());
+	assert(ambiguousCount == building.ambiguousNodeSequences.size());
+	assert(nonAmbiguousCount == building.nodeSequences.size());
 	firstAmbiguous = nonAmbiguousCount;
 
 	if (ambiguousCount == 0) return;
 
 	//the ambiguous nodes were added in the reverse order, reverse the sequence containers too
-	std::reverse(ambiguousNodeSequences.begin(), ambiguousNodeSequences.end());
+	std::reverse(building.ambiguousNodeSequences.begin(), building.ambiguousNodeSequences.end());
 
-	nodeLength = reorder(nodeLength, renumbering);
-	nodeOffset = reorder(nodeOffset, renumbering);
-	nodeIDs = reorder(nodeIDs, renumbering);
-	inNeighbors = reorder(inNeighbors, renumbering);
-	outNeighbors = reorder(outNeighbors, renumbering);
-	reverse = reorder(reverse, renumbering);
-	for (auto& pair : nodeLookup)
+	building.nodeLength = reorder(building.nodeLength, renumbering);
+	building.nodeOffset = reorder(building.nodeOffset, renumbering);
+	building.nodeIDs = reorder(building.nodeIDs, renumbering);
+	building.reverse = reorder(building.reverse, renumbering);
+	building.originalNodeSplitNodes = renumber(building.originalNodeSplitNodes, renumbering);
+	for (auto& edge : building.edges)
 	{
-		pair.second = renumber(pair.second, renumbering);
-	}
-	assert(inNeighbors.size() == outNeighbors.size());
-	for (size_t i = 0; i < inNeighbors.size(); i++)
-	{
-		inNeighbors[i] = renumber(inNeighbors[i], renumbering);
-		outNeighbors[i] = renumber(outNeighbors[i], renumbering);
+		edge.first = renumbering[edge.first];
+		edge.second = renumbering[edge.second];
 	}
 
 #ifndef NDEBUG
-	assert(inNeighbors.size() == outNeighbors.size());
-	for (size_t i = 0; i < inNeighbors.size(); i++)
+	for (size_t i = 0; i < building.originalNodeIDs.size(); i++)
 	{
-		for (auto neighbor : inNeighbors[i])
-		{
-			assert(std::find(outNeighbors[neighbor].begin(), outNeighbors[neighbor].end(), i) != outNeighbors[neighbor].end());
-		}
-		for (auto neighbor : outNeighbors[i])
+		size_t foundSize = 0;
+		std::set<size_t> offsets;
+		for (size_t j = building.originalNodeSplitStart[i]; j < building.originalNodeSplitStart[i+1]; j++)
 		{
-			assert(std::find(inNeighbors[neighbor].begin(), inNeighbors[neighbor].end(), i) != inNeighbors[neighbor].end());
+			size_t node = building.originalNodeSplitNodes[j];
+			assert(offsets.count(building.nodeOffset[node]) == 0);
+			offsets.insert(building.nodeOffset[node]);
+			assert(building.nodeIDs[node] == building.originalNodeIDs[i]);
+			foundSize += building.nodeLength[node];
 		}
+		assert(foundSize == building.originalNodeSizes[i]);
 	}
-	for (auto pair : nodeLookup)
+#endif
+}
+
+//numbers the nodes in breadth-first order over both edge directions, so that nodes which are close in the graph are close in memory
+//non-ambiguous and ambiguous nodes are numbered separately so the ambiguous nodes stay at the end
+void AlignmentGraph::RenumberForLocality()
+{
+	assert(firstAmbiguous <= building.nodeLength.size());
+	assert(!finalized);
+	size_t numNodes = building.nodeLength.size();
+	AdjacencyList forward { numNodes, building.edges };
+	for (auto& edge : building.edges)
 	{
-		size_t foundSize = 0;
-		std::set<size_t> offsets;
-		for (auto node : pair.second)
+		std::swap(edge.first, edge.second);
+	}
+	AdjacencyList backward { numNodes, building.edges };
+	for (auto& edge : building.edges)
+	{
+		std::swap(edge.first, edge.second);
+	}
+	std::vector<size_t> renumbering;
+	renumbering.resize(numNodes, std::numeric_limits<size_t>::max());
+	size_t nextNonAmbiguous = 0;
+	size_t nextAmbiguous = firstAmbiguous;
+	std::vector<size_t> queue;
+	queue.reserve(numNodes);
+	for (size_t start = 0; start < numNodes; start++)
+	{
+		if (renumbering[start] != std::numeric_limits<size_t>::max()) continue;
+		size_t queuePos = queue.size();
+		queue.push_back(start);
+		renumbering[start] = 0;
+		while (queuePos < queue.size())
 		{
-			assert(offsets.count(nodeOffset[node]) == 0);
-			offsets.insert(nodeOffset[node]);
-			assert(nodeIDs[node] == pair.first);
-			foundSize += nodeLength[node];
+			size_t node = queue[queuePos];
+			queuePos++;
+			renumbering[node] = (node < firstAmbiguous) ? nextNonAmbiguous++ : nextAmbiguous++;
+			for (auto neighbor : forward[node])
+			{
+				if (renumbering[neighbor] != std::numeric_limits<size_t>::max()) continue;
+				renumbering[neighbor] = 0;
+				queue.push_back(neighbor);
+			}
+			for (auto neighbor : backward[node])
+			{
+				if (renumbering[neighbor] != std::numeric_limits<size_t>::max()) continue;
+				renumbering[neighbor] = 0;
+				queue.push_back(neighbor);
+			}
 		}
-		assert(foundSize == originalNodeSize[pair.first]);
 	}
-#endif
+	assert(queue.size() == numNodes);
+	assert(nextNonAmbiguous == firstAmbiguous);
+	assert(nextAmbiguous == numNodes);
+
+	//the sequences are stored separately for the non-ambiguous and ambiguous nodes
+	std::vector<NodeChunkSequence> newNodeSequences;
+	newNodeSequences.resize(building.nodeSequences.size());
+	for (size_t i = 0; i < firstAmbiguous; i++)
+	{
+		newNodeSequences[renumbering[i]] = building.nodeSequences[i];
+	}
+	std::vector<AmbiguousChunkSequence> newAmbiguousNodeSequences;
+	newAmbiguousNodeSequences.resize(building.ambiguousNodeSequences.size());
+	for (size_t i = firstAmbiguous; i < numNodes; i++)
+	{
+		newAmbiguousNodeSequences[renumbering[i] - firstAmbiguous] = building.ambiguousNodeSequences[i - firstAmbiguous];
+	}
+	building.nodeSequences = std::move(newNodeSequences);
+	building.ambiguousNodeSequences = std::move(newAmbiguousNodeSequences);
+	building.nodeLength = reorder(building.nodeLength, renumbering);
+	building.nodeOffset = reorder(building.nodeOffset, renumbering);
+	building.nodeIDs = reorder(building.nodeIDs, renumbering);
+	building.reverse = reorder(building.reverse, renumbering);
+	building.originalNodeSplitNodes = renumber(building.originalNodeSplitNodes, renumbering);
+	for (auto& edge : building.edges)
+	{
+		edge.first = renumbering[edge.first];
+		edge.second = renumbering[edge.second];
+	}
 }
 
 void AlignmentGraph::doComponentOrder()
@@ -545,7 +829,8 @@ void AlignmentGraph::doComponentOrder()
 	onStack.resize(nodeLength.size(), false);
 	size_t checknode = 0;
 	size_t nextComponent = 0;
-	componentNumber.resize(nodeLength.size(), std::numeric_limits<size_t>::max());
+	std::vector<uint32_t> newComponentNumber;
+	newComponentNumber.resize(nodeLength.size(), std::numeric_limits<uint32_t>::max());
 	while (true)
 	{
 		if (callStack.size() == 0)
@@ -616,28 +901,29 @@ void AlignmentGraph::doComponentOrder()
 						w = stack.back();
 						stack.pop_back();
 						onStack[w] = false;
-						componentNumber[w] = nextComponent;
+						newComponentNumber[w] = nextComponent;
 					} while (w != v);
 					nextComponent++;
 				}
 		}
 	}
 	assert(stack.size() == 0);
-	for (size_t i = 0; i < componentNumber.size(); i++)
+	for (size_t i = 0; i < newComponentNumber.size(); i++)
 	{
-		assert(componentNumber[i] != std::numeric_limits<size_t>::max());
-		assert(componentNumber[i] <= nextComponent-1);
-		componentNumber[i] = nextComponent-1-componentNumber[i];
+		assert(newComponentNumber[i] != std::numeric_limits<uint32_t>::max());
+		assert(newComponentNumber[i] <= nextComponent-1);
+		newComponentNumber[i] = nextComponent-1-newComponentNumber[i];
 	}
 #ifdef EXTRACORRECTNESSASSERTIONS
 	for (size_t i = 0; i < nodeLength.size(); i++)
 	{
 		for (auto neighbor : outNeighbors[i])
 		{
-			assert(componentNumber[neighbor] >= componentNumber[i]);
+			assert(newComponentNumber[neighbor] >= newComponentNumber[i]);
 		}
 	}
 #endif
+	this->componentNumber.assign(std::move(newComponentNumber));
 }
 
 size_t AlignmentGraph::ComponentSize() const
@@ -6,7 +6,47 @@
 #include <set>
 #include <unordered_map>
 #include <tuple>
+#include <cstdint>
 #include "ThreadReadAssertion.h"
+#include "IndexFile.h"
+
+//adjacency lists in compressed sparse row form, the neighbors of node i are targets[offsets[i]] to targets[offsets[i+1]-1]
+//one flat array for all edges instead of one allocation per node, and 32-bit node indices
+class AdjacencyList
+{
+public:
+	class NeighborRange
+	{
+	public:
+		NeighborRange(const uint32_t* start, const uint32_t* stop) : start(start), stop(stop) {}
+		const uint32_t* begin() const { return start; }
+		const uint32_t* end() const { return stop; }
+		size_t size() const { return stop - start; }
+		size_t operator[](size_t index) const
+		{
+			assert(index < size());
+			return start[index];
+		}
+	private:
+		const uint32_t* start;
+		const uint32_t* stop;
+	};
+	AdjacencyList();
+	//edges are (node, neighbor) pairs, the neighbors of each node are kept in the order they are in edges, without duplicates
+	AdjacencyList(size_t numNodes, const std::vector<std::pair<uint32_t, uint32_t>>& edges);
+	NeighborRange operator[](size_t node) const
+	{
+		assert(node + 1 < offsets.size());
+		return NeighborRange { targets.data() + offsets[node], targets.data() + offsets[node+1] };
+	}
+	size_t size() const;
+	size_t numEdges() const;
+	void saveTo(IndexFileWriter& file) const;
+	bool loadFrom(IndexFileReader& file);
+private:
+	MappedArray<uint64_t> offsets;
+	MappedArray<uint32_t> targets;
+};
 
 
 class AlignmentGraph
@@ -87,7 +127,11 @@ public:
 	void ReserveNodes(size_t numNodes, size_t numSplitNodes);
 	void AddNode(int nodeId, const std::string& sequence, const std::string& name, bool reverseNode, const std::vector<size_t>& breakpoints);
 	void AddEdgeNodeId(int node_id_from, int node_id_to, size_t startOffset);
-	void Finalize(int wordSize, bool doComponents);
+	void Finalize(int wordSize, bool doComponents, bool localityOrder);
+	//the finalized graph can be stored in a graph index and mapped from it instead of building it again
+	//loading fails if the index is from a different graph file, or was built with different doComponents or localityOrder
+	bool SaveTo(const std::string& indexFile, const GraphFingerprint& graph, bool doComponents, bool localityOrder) const;
+	bool LoadFrom(const std::string& indexFile, const GraphFingerprint& graph, bool doComponents, bool localityOrder);
 	AlignmentGraph GetSubgraph(const std::unordered_map<size_t, size_t>& nodeMapping) const;
 	std::pair<int, size_t> GetReversePosition(int nodeId, size_t offset) const;
 	size_t GetReverseNode(size_t node) const;
@@ -100,25 +144,57 @@ public:
 	// size_t MinDistance(size_t pos, const std::vector<size_t>& targets) const;
 	// std::set<size_t> ProjectForward(const std::set<size_t>& startpositions, size_t amount) const;
 	std::string OriginalNodeName(int nodeId) const;
+	size_t OriginalNodeSize(int nodeId) const;
 	size_t ComponentSize() const;
 
 private:
 	void AddNode(int nodeId, int offset, const std::string& sequence, bool reverseNode);
 	void RenumberAmbiguousToEnd();
+	void RenumberForLocality();
 	void doComponentOrder();
-	std::vector<size_t> nodeLength;
-	std::unordered_map<int, std::vector<size_t>> nodeLookup;
-	std::unordered_map<int, size_t> originalNodeSize;
-	std::unordered_map<int, std::string> originalNodeName;
-	std::vector<size_t> nodeOffset;
-	std::vector<int> nodeIDs;
-	std::vector<std::vector<size_t>> inNeighbors;
-	std::vector<std::vector<size_t>> outNeighbors;
-	std::vector<bool> reverse;
-	std::vector<NodeChunkSequence> nodeSequences;
-	std::vector<AmbiguousChunkSequence> ambiguousNodeSequences;
-	std::vector<bool> ambiguousNodes;
-	std::vector<size_t> componentNumber;
+	void buildOriginalNodeTables();
+	size_t originalNodeIndex(int nodeId) const;
+	//the graph is built in these, Finalize moves them to the read-only arrays below
+	struct BuildStorage
+	{
+		std::vector<uint32_t> nodeLength;
+		//the original nodes in the order they were added, laid out like the sorted tables below
+		//the split nodes of an original node are added consecutively, renumbering only changes the values in originalNodeSplitNodes
+		std::unordered_map<int, uint32_t> originalNodeIndex;
+		std::vector<int> originalNodeIDs;
+		std::vector<uint64_t> originalNodeSizes;
+		std::vector<uint64_t> originalNodeSplitStart { 0 };
+		std::vector<uint32_t> originalNodeSplitNodes;
+		std::vector<uint64_t> originalNodeNameStart { 0 };
+		std::vector<char> originalNodeNames;
+		std::vector<uint32_t> nodeOffset;
+		std::vector<int> nodeIDs;
+		//edges as (from, to) in the order they were added, compacted into inNeighbors and outNeighbors by Finalize
+		std::vector<std::pair<uint32_t, uint32_t>> edges;
+		std::vector<bool> reverse;
+		std::vector<NodeChunkSequence> nodeSequences;
+		std::vector<AmbiguousChunkSequence> ambiguousNodeSequences;
+		std::vector<bool> ambiguousNodes;
+	};
+	BuildStorage building;
+	//node indices and offsets are 32-bit, the max value is the "no node" marker so the graph can have at most 2^32-2 split nodes
+	//these are either owned or point into a mapped graph index
+	MappedArray<uint32_t> nodeLength;
+	MappedArray<uint32_t> nodeOffset;
+	MappedArray<int> nodeIDs;
+	AdjacencyList inNeighbors;
+	AdjacencyList outNeighbors;
+	MappedArray<NodeChunkSequence> nodeSequences;
+	MappedArray<AmbiguousChunkSequence> ambiguousNodeSequences;
+	MappedArray<uint32_t> componentNumber;
+	//original nodes sorted by id. the split nodes of original node i are originalNodeSplitNodes[originalNodeSplitStart[i]] to originalNodeSplitNodes[originalNodeSplitStart[i+1]-1], in offset order
+	//its name is originalNodeNames[originalNodeNameStart[i]] to originalNodeNames[originalNodeNameStart[i+1]-1]
+	MappedArray<int> originalNodeIDs;
+	MappedArray<uint64_t> originalNodeSizes;
+	MappedArray<uint64_t> originalNodeSplitStart;
+	MappedArray<uint32_t> originalNodeSplitNodes;
+	MappedArray<uint64_t> originalNodeNameStart;
+	MappedArray<char> originalNodeNames;
 	size_t firstAmbiguous;
 	bool finalized;
 
@@ -129,6 +205,8 @@ private:
 	template <typename LengthType, typename ScoreType, typename Word>
 	friend class GraphAlignerBitvectorBanded;
 	friend class DirectedGraph;
+	friend class MinimizerSeeder;
+	friend class MummerSeeder;
 };
 
 
@@ -3,6 +3,7 @@
 
 #include <queue>
 #include "ThreadReadAssertion.h"
+#include "PagedArray.h"
 
 template <typename T>
 class ArrayPriorityQueue
@@ -10,11 +11,10 @@ class ArrayPriorityQueue
 public:
 	ArrayPriorityQueue(size_t maxPriority, size_t maxExtras) :
 	activeQueues(),
-	extras(),
+	extras(maxExtras),
 	queues(),
 	numItems(0)
 	{
-		extras.resize(maxExtras, std::vector<T>{});
 		queues.resize(maxPriority);
 	}
 #ifdef NDEBUG
@@ -83,7 +83,8 @@ public:
 	void removeExtras(size_t index)
 	{
 		assert(index < extras.size());
-		extras[index].clear();
+		if (getExtras(index).size() == 0) return;
+		extras.release(index);
 	}
 	size_t extraSize(size_t index) const
 	{
@@ -96,7 +97,8 @@ private:
 		return item.target;
 	}
 	std::priority_queue<size_t, std::vector<size_t>, std::greater<size_t>> activeQueues;
-	std::vector<std::vector<T>> extras;
+	//paged so the per-thread queues only take memory for the parts of the graph the thread has aligned to
+	PagedArray<std::vector<T>> extras;
 	std::vector<std::vector<T>> queues;
 	size_t numItems;
 };
@@ -0,0 +1,233 @@
+#include <iostream>
+#include <vector>
+#include <queue>
+#include <random>
+#include <chrono>
+#include <string>
+#include "ComponentPriorityQueue.h"
+
+//compares the radix heap ComponentPriorityQueue against the binary heap it replaced on a synthetic DAG workload
+//usage: BenchmarkPriorityQueue [nodes] [slices]
+
+//the binary heap version of ComponentPriorityQueue, kept here as the reference
+template <typename T>
+class HeapComponentPriorityQueue
+{
+	struct PrioritizedItem
+	{
+		PrioritizedItem(size_t component, int score, size_t index) : component(component), score(score), index(index) {}
+		size_t component;
+		int score;
+		size_t index;
+		bool operator<(const PrioritizedItem& other) const { return component < other.component || (component == other.component && score < other.score); }
+		bool operator>(const PrioritizedItem& other) const { return component > other.component || (component == other.component && score > other.score); }
+	};
+public:
+	HeapComponentPriorityQueue(size_t maxNode) :
+	activeQueues(),
+	active(maxNode),
+	extras(maxNode)
+	{
+	}
+#ifdef NDEBUG
+	__attribute__((always_inline))
+#endif
+	T& top()
+	{
+		assert(activeQueues.size() > 0);
+		auto index = activeQueues.top().index;
+		assert(active[index]);
+		assert(extras[index].size() > 0);
+		return extras[index][0];
+	}
+#ifdef NDEBUG
+	__attribute__((always_inline))
+#endif
+	void pop()
+	{
+		assert(activeQueues.size() > 0);
+		size_t index = activeQueues.top().index;
+		assert(active[index]);
+		assert(extras[index].size() > 0);
+		extras.release(index);
+		active.set(index, false);
+		activeQueues.pop();
+	}
+#ifdef NDEBUG
+	__attribute__((always_inline))
+#endif
+	size_t size() const
+	{
+		return activeQueues.size();
+	}
+	void insert(size_t component, const T& item)
+	{
+		assert(false);
+	}
+#ifdef NDEBUG
+	__attribute__((always_inline))
+#endif
+	void insert(size_t component, int score, const T& item)
+	{
+		size_t index = getId(item);
+		assert(index < extras.size());
+		if (!active[index])
+		{
+			assert(extras[index].size() == 0);
+			activeQueues.emplace(component, score, index);
+			active.set(index, true);
+		}
+		extras[index].push_back(item);
+	}
+	void clear()
+	{
+		while (activeQueues.size() > 0)
+		{
+			size_t index = activeQueues.top().index;
+			assert(active[index]);
+			removeExtras(index);
+			active.set(index, false);
+			activeQueues.pop();
+		}
+	}
+	const std::vector<T>& getExtras(size_t index) const
+	{
+		assert(index < extras.size());
+		return extras[index];
+	}
+	void removeExtras(size_t index)
+	{
+		assert(index < extras.size());
+		if (getExtras(index).size() == 0) return;
+		extras.release(index);
+	}
+	size_t extraSize(size_t index) const
+	{
+		assert(index < extras.size());
+		return extras[index].size();
+	}
+	bool valid() const
+	{
+		return active.size() > 0;
+	}
+private:
+	size_t getId(const T& item) const
+	{
+		return item.target;
+	}
+	std::priority_queue<PrioritizedItem, std::vector<PrioritizedItem>, std::greater<PrioritizedItem>> activeQueues;
+	//paged so the per-thread queues only take memory for the parts of the graph the thread has aligned to
+	PagedArray<bool> active;
+	PagedArray<std::vector<T>> extras;
+};
+
+struct BenchmarkItem
+{
+	size_t target;
+	int score;
+};
+
+struct BenchmarkGraph
+{
+	//nodes are numbered in topological order and each node is its own component, like in a DAG
+	std::vector<std::vector<size_t>> outNeighbors;
+};
+
+BenchmarkGraph makeGraph(size_t numNodes, std::mt19937& rand)
+{
+	BenchmarkGraph result;
+	result.outNeighbors.resize(numNodes);
+	for (size_t i = 0; i < numNodes; i++)
+	{
+		size_t numNeighbors = 1 + rand() % 3;
+		for (size_t j = 0; j < numNeighbors; j++)
+		{
+			size_t neighbor = i + 1 + rand() % 64;
+			if (neighbor < numNodes) result.outNeighbors[i].push_back(neighbor);
+		}
+	}
+	return result;
+}
+
+//processes a band of nodes per slice the same way calculateSlice does: pop a node, read its extras, and push its out-neighbors while they stay in the band
+//returns a checksum of the pop order so the implementations can be checked against each other
+template <typename Queue>
+size_t runSlices(const BenchmarkGraph& graph, Queue& queue, size_t numSlices, size_t& operations)
+{
+	std::mt19937 rand { 1 };
+	size_t checksum = 0;
+	size_t numNodes = graph.outNeighbors.size();
+	for (size_t slice = 0; slice < numSlices; slice++)
+	{
+		size_t bandStart = rand() % (numNodes - 1000);
+		int bandEnd = 40;
+		for (size_t i = 0; i < 8; i++)
+		{
+			size_t node = bandStart + rand() % 100;
+			int score = rand() % 8;
+			queue.insert(node, score, BenchmarkItem { node, score });
+			operations++;
+		}
+		size_t popped = 0;
+		while (queue.size() > 0)
+		{
+			auto item = queue.top();
+			size_t node = item.target;
+			int minScore = item.score;
+			for (auto extra : queue.getExtras(node))
+			{
+				minScore = std::min(minScore, extra.score);
+			}
+			queue.pop();
+			operations++;
+			popped++;
+			checksum = checksum * 31 + node * 7 + minScore;
+			for (auto neighbor : graph.outNeighbors[node])
+			{
+				int score = minScore + rand() % 4;
+				if (score > bandEnd) continue;
+				queue.insert(neighbor, score, BenchmarkItem { neighbor, score });
+				operations++;
+			}
+		}
+		queue.clear();
+	}
+	return checksum;
+}
+
+template <typename Queue>
+void benchmark(const std::string& name, const BenchmarkGraph& graph, size_t numSlices, size_t& checksum)
+{
+	Queue queue { graph.outNeighbors.size() };
+	size_t operations = 0;
+	auto timeStart = std::chrono::steady_clock::now();
+	checksum = runSlices(graph, queue, numSlices, operations);
+	auto timeEnd = std::chrono::steady_clock::now();
+	auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(timeEnd - timeStart).count();
+	std::cout << name << ": " << operations << " operations, " << time / 1000000 << "ms, " << (double)time / operations << "ns per operation" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	size_t numNodes = 1000000;
+	size_t numSlices = 2000;
+	if (argc > 1) numNodes = std::stoull(argv[1]);
+	if (argc > 2) numSlices = std::stoull(argv[2]);
+	if (numNodes < 2000)
+	{
+		std::cerr << "at least 2000 nodes are needed" << std::endl;
+		return 1;
+	}
+	std::mt19937 rand { 0 };
+	BenchmarkGraph graph = makeGraph(numNodes, rand);
+	size_t heapChecksum = 0;
+	size_t radixChecksum = 0;
+	benchmark<HeapComponentPriorityQueue<BenchmarkItem>>("binary heap", graph, numSlices, heapChecksum);
+	benchmark<ComponentPriorityQueue<BenchmarkItem>>("radix heap", graph, numSlices, radixChecksum);
+	if (heapChecksum != radixChecksum)
+	{
+		std::cerr << "the queues popped the nodes in different orders" << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -2,6 +2,7 @@
 #include <sstream>
 #include <cassert>
 #include <unordered_map>
+#include <unordered_set>
 #include "CommonUtils.h"
 #include "vg.pb.h"
 #include "fastqloader.h"
@@ -48,6 +49,33 @@ static std::vector<bool> getAllowedNucleotides()
 
 auto allowed = getAllowedNucleotides();
 
+//the next whitespace separated field of a gfa line starting from pos
+static std::string nextField(const std::string& line, size_t& pos)
+{
+	size_t start = line.find_first_not_of(" \t\r", pos);
+	if (start == std::string::npos)
+	{
+		pos = line.size();
+		return "";
+	}
+	size_t end = line.find_first_of(" \t\r", start);
+	if (end == std::string::npos) end = line.size();
+	pos = end;
+	return line.substr(start, end - start);
+}
+
+//the overlap field of an L line, either empty, * or a number of matches like 10M
+static size_t parseOverlap(const std::string& overlap, size_t lineIndex)
+{
+	if (overlap.size() == 0 || overlap == "*") return 0;
+	if (overlap[0] == '-') throw CommonUtils::InvalidGraphException { "Edge overlap cannot be negative. Fix the graph" };
+	size_t digits = std::min(overlap.find_first_not_of("0123456789"), overlap.size());
+	//at most 9 digits so the overlap fits in an int
+	bool valid = digits > 0 && digits <= 9 && (digits == overlap.size() || (digits + 1 == overlap.size() && overlap[digits] == 'M'));
+	if (!valid) throw CommonUtils::InvalidGraphException { "Invalid edge overlap \"" + overlap + "\" on line " + std::to_string(lineIndex + 1) + ", only overlaps of the form <number>M are supported. Fix the graph" };
+	return std::stoul(overlap.substr(0, digits));
+}
+
 DirectedGraph::Node::Node(int nodeId, int originalNodeId, bool rightEnd, std::string sequence, std::string name) :
 nodeId(nodeId),
 originalNodeId(originalNodeId),
@@ -131,7 +159,7 @@ std::pair<DirectedGraph::Edge, DirectedGraph::Edge> DirectedGraph::ConvertGFAEdg
 	return std::make_pair(DirectedGraph::Edge { fromRight, toRight, overlap }, DirectedGraph::Edge { toLeft, fromLeft, overlap });
 }
 
-AlignmentGraph DirectedGraph::StreamVGGraphFromFile(std::string filename, bool tryDAG)
+AlignmentGraph DirectedGraph::StreamVGGraphFromFile(std::string filename, bool tryDAG, bool localityOrder)
 {
 	AlignmentGraph result;
 	{
@@ -147,7 +175,7 @@ AlignmentGraph DirectedGraph::StreamVGGraphFromFile(std::string filename, bool t
 				{
 					if (!allowed[g.node(i).sequence()[j]])
 					{
-						throw CommonUtils::InvalidGraphException("Invalid sequence character: " + g.node(i).sequence()[j]);
+						throw CommonUtils::InvalidGraphException(std::string("Invalid sequence character: ") + g.node(i).sequence()[j]);
 					}
 				}
 				auto nodes = ConvertVGNodeToNodes(g.node(i));
@@ -174,11 +202,160 @@ AlignmentGraph DirectedGraph::StreamVGGraphFromFile(std::string filename, bool t
 		};
 		stream::for_each(graphfile, lambda);
 	}
-	result.Finalize(64, tryDAG);
+	result.Finalize(64, tryDAG, localityOrder);
+	return result;
+}
+
+//reads the file twice so that only one node's sequence is in memory besides the graph being built
+//the first pass assigns the node ids and collects the edges and the node lengths, the second pass adds the nodes
+//the node ids are the gfa names if all of them are integers, otherwise they are numbered in the order they appear and the names are kept
+AlignmentGraph DirectedGraph::StreamGFAGraphFromFile(std::string filename, bool tryDAG, bool localityOrder)
+{
+	struct GfaEdge
+	{
+		int from;
+		bool fromForward;
+		int to;
+		bool toForward;
+		size_t overlap;
+	};
+	std::unordered_map<std::string, int> nameMapping;
+	std::vector<size_t> nodeLengths;
+	std::vector<bool> hasSequence;
+	std::vector<size_t> sequenceLine;
+	//S lines of a duplicate node except the last one, the last sequence is used like in GfaGraph
+	std::unordered_set<size_t> shadowedLines;
+	std::vector<GfaEdge> edges;
+	auto getId = [&nameMapping, &nodeLengths, &hasSequence, &sequenceLine](const std::string& name)
+	{
+		auto found = nameMapping.find(name);
+		if (found != nameMapping.end()) return found->second;
+		int result = nameMapping.size();
+		nameMapping[name] = result;
+		nodeLengths.push_back(0);
+		hasSequence.push_back(false);
+		sequenceLine.push_back(0);
+		return result;
+	};
+	{
+		std::ifstream graphfile { filename };
+		std::string line;
+		for (size_t lineIndex = 0; std::getline(graphfile, line); lineIndex++)
+		{
+			if (line.size() == 0) continue;
+			if (line[0] == 'S')
+			{
+				size_t pos = 1;
+				int id = getId(nextField(line, pos));
+				size_t seqStart = std::min(line.find_first_not_of(" \t\r", pos), line.size());
+				size_t seqEnd = std::min(line.find_first_of(" \t\r", seqStart), line.size());
+				if (hasSequence[id]) shadowedLines.insert(sequenceLine[id]);
+				hasSequence[id] = true;
+				sequenceLine[id] = lineIndex;
+				nodeLengths[id] = seqEnd - seqStart;
+			}
+			else if (line[0] == 'L')
+			{
+				size_t pos = 1;
+				GfaEdge edge;
+				edge.from = getId(nextField(line, pos));
+				edge.fromForward = nextField(line, pos) == "+";
+				edge.to = getId(nextField(line, pos));
+				edge.toForward = nextField(line, pos) == "+";
+				edge.overlap = parseOverlap(nextField(line, pos), lineIndex);
+				edges.push_back(edge);
+			}
+		}
+	}
+	bool allIdsIntegers = true;
+	for (const auto& pair : nameMapping)
+	{
+		char* p;
+		strtol(pair.first.c_str(), &p, 10);
+		if (*p)
+		{
+			allIdsIntegers = false;
+			break;
+		}
+	}
+	std::vector<int> nodeIds;
+	nodeIds.resize(nameMapping.size());
+	for (const auto& pair : nameMapping)
+	{
+		nodeIds[pair.second] = allIdsIntegers ? std::stoi(pair.first) : pair.second;
+	}
+	//integer names are parsed again in the second pass, only other names need the mapping
+	if (allIdsIntegers) std::unordered_map<std::string, int>().swap(nameMapping);
+	std::vector<size_t>().swap(sequenceLine);
+	//an overlap splits the target node at the end of the overlap, in both directions of the edge
+	std::unordered_map<int, std::vector<size_t>> breakpoints;
+	for (auto edge : edges)
+	{
+		if (edge.overlap == 0) continue;
+		auto pair = ConvertGFAEdgeToEdges(nodeIds[edge.from], edge.fromForward ? "+" : "-", nodeIds[edge.to], edge.toForward ? "+" : "-", edge.overlap);
+		breakpoints[pair.first.toId].push_back(edge.overlap);
+		breakpoints[pair.second.toId].push_back(edge.overlap);
+	}
+	AlignmentGraph result;
+	{
+		size_t numNodes = 0;
+		size_t numSplitNodes = 0;
+		for (size_t i = 0; i < nodeLengths.size(); i++)
+		{
+			if (!hasSequence[i]) continue;
+			numNodes += 2;
+			numSplitNodes += 2 * ((nodeLengths[i] + AlignmentGraph::SPLIT_NODE_SIZE - 1) / AlignmentGraph::SPLIT_NODE_SIZE);
+		}
+		result.ReserveNodes(numNodes, numSplitNodes);
+	}
+	{
+		std::ifstream graphfile { filename };
+		std::string line;
+		for (size_t lineIndex = 0; std::getline(graphfile, line); lineIndex++)
+		{
+			if (line.size() == 0 || line[0] != 'S') continue;
+			if (shadowedLines.count(lineIndex) == 1) continue;
+			size_t pos = 1;
+			std::string name = nextField(line, pos);
+			std::string sequence = nextField(line, pos);
+			for (size_t j = 0; j < sequence.size(); j++)
+			{
+				if (!allowed[sequence[j]])
+				{
+					throw CommonUtils::InvalidGraphException(std::string("Invalid sequence character: ") + sequence[j]);
+				}
+			}
+			auto nodes = ConvertGFANodeToNodes(allIdsIntegers ? std::stoi(name) : nameMapping.at(name), sequence, allIdsIntegers ? "" : name);
+			std::vector<size_t> breakpointsFw;
+			std::vector<size_t> breakpointsBw;
+			if (breakpoints.count(nodes.first.nodeId) == 1) breakpointsFw = breakpoints.at(nodes.first.nodeId);
+			if (breakpoints.count(nodes.second.nodeId) == 1) breakpointsBw = breakpoints.at(nodes.second.nodeId);
+			breakpointsFw.push_back(0);
+			breakpointsFw.push_back(sequence.size());
+			breakpointsBw.push_back(0);
+			breakpointsBw.push_back(sequence.size());
+			std::sort(breakpointsFw.begin(), breakpointsFw.end());
+			std::sort(breakpointsBw.begin(), breakpointsBw.end());
+			result.AddNode(nodes.first.nodeId, nodes.first.sequence, nodes.first.name, !nodes.first.rightEnd, breakpointsFw);
+			result.AddNode(nodes.second.nodeId, nodes.second.sequence, nodes.second.name, !nodes.second.rightEnd, breakpointsBw);
+		}
+	}
+	std::unordered_map<std::string, int>().swap(nameMapping);
+	std::unordered_set<size_t>().swap(shadowedLines);
+	for (auto edge : edges)
+	{
+		//edges to nodes without a sequence are dropped
+		if (!hasSequence[edge.from] || !hasSequence[edge.to]) continue;
+		auto pair = ConvertGFAEdgeToEdges(nodeIds[edge.from], edge.fromForward ? "+" : "-", nodeIds[edge.to], edge.toForward ? "+" : "-", edge.overlap);
+		result.AddEdgeNodeId(pair.first.fromId, pair.first.toId, pair.first.overlap);
+		result.AddEdgeNodeId(pair.second.fromId, pair.second.toId, pair.second.overlap);
+	}
+	std::vector<GfaEdge>().swap(edges);
+	result.Finalize(64, tryDAG, localityOrder);
 	return result;
 }
 
-AlignmentGraph DirectedGraph::BuildFromVG(const vg::Graph& graph, bool tryDAG)
+AlignmentGraph DirectedGraph::BuildFromVG(const vg::Graph& graph, bool tryDAG, bool localityOrder)
 {
 	AlignmentGraph result;
 	std::vector<size_t> breakpointsFw;
@@ -191,7 +368,7 @@ AlignmentGraph DirectedGraph::BuildFromVG(const vg::Graph& graph, bool tryDAG)
 		{
 			if (!allowed[graph.node(i).sequence()[j]])
 			{
-				throw CommonUtils::InvalidGraphException("Invalid sequence character: " + graph.node(i).sequence()[j]);
+				throw CommonUtils::InvalidGraphException(std::string("Invalid sequence character: ") + graph.node(i).sequence()[j]);
 			}
 		}
 		auto nodes = ConvertVGNodeToNodes(graph.node(i));
@@ -208,11 +385,11 @@ AlignmentGraph DirectedGraph::BuildFromVG(const vg::Graph& graph, bool tryDAG)
 		result.AddEdgeNodeId(edges.first.fromId, edges.first.toId, edges.first.overlap);
 		result.AddEdgeNodeId(edges.second.fromId, edges.second.toId, edges.second.overlap);
 	}
-	result.Finalize(64, tryDAG);
+	result.Finalize(64, tryDAG, localityOrder);
 	return result;
 }
 
-AlignmentGraph DirectedGraph::BuildFromGFA(const GfaGraph& graph, bool tryDAG)
+AlignmentGraph DirectedGraph::BuildFromGFA(const GfaGraph& graph, bool tryDAG, bool localityOrder)
 {
 	AlignmentGraph result;
 	std::unordered_map<int, std::vector<size_t>> breakpoints;
@@ -231,7 +408,7 @@ AlignmentGraph DirectedGraph::BuildFromGFA(const GfaGraph& graph, bool tryDAG)
 		{
 			if (!allowed[node.second[j]])
 			{
-				throw CommonUtils::InvalidGraphException("Invalid sequence character: " + node.second[j]);
+				throw CommonUtils::InvalidGraphException(std::string("Invalid sequence character: ") + node.second[j]);
 			}
 		}
 		std::string name = graph.OriginalNodeName(node.first);
@@ -261,6 +438,6 @@ AlignmentGraph DirectedGraph::BuildFromGFA(const GfaGraph& graph, bool tryDAG)
 			result.AddEdgeNodeId(pair.second.fromId, pair.second.toId, pair.second.overlap);
 		}
 	}
-	result.Finalize(64, tryDAG);
+	result.Finalize(64, tryDAG, localityOrder);
 	return result;
 }
@@ -31,9 +31,10 @@ public:
 	static std::pair<Edge, Edge> ConvertVGEdgeToEdges(const vg::Edge& edge);
 	static std::pair<Node, Node> ConvertGFANodeToNodes(int id, const std::string& seq, const std::string& name);
 	static std::pair<Edge, Edge> ConvertGFAEdgeToEdges(int from, const std::string& fromStart, int to, const std::string& toEnd, size_t overlap);
-	static AlignmentGraph BuildFromVG(const vg::Graph& graph, bool tryDAG);
-	static AlignmentGraph BuildFromGFA(const GfaGraph& graph, bool tryDAG);
-	static AlignmentGraph StreamVGGraphFromFile(std::string filename, bool tryDAG);
+	static AlignmentGraph BuildFromVG(const vg::Graph& graph, bool tryDAG, bool localityOrder);
+	static AlignmentGraph BuildFromGFA(const GfaGraph& graph, bool tryDAG, bool localityOrder);
+	static AlignmentGraph StreamVGGraphFromFile(std::string filename, bool tryDAG, bool localityOrder);
+	static AlignmentGraph StreamGFAGraphFromFile(std::string filename, bool tryDAG, bool localityOrder);
 private:
 };
 
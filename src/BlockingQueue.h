@@ -0,0 +1,98 @@
+#ifndef BlockingQueue_h
+#define BlockingQueue_h
+
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <limits>
+#include "ThreadReadAssertion.h"
+
+//bounded multi-producer multi-consumer queue
+//push blocks while the queue is full, either by item count or by the total weight of the items, popBatch blocks while the queue is empty
+//an item heavier than maxWeight is still accepted into an empty queue
+//close() marks the end of the stream, after which popBatch returns 0 once the queue has been drained
+template <typename T>
+class BlockingQueue
+{
+	struct WeightedItem
+	{
+		WeightedItem(T&& item, size_t weight) : item(std::move(item)), weight(weight) {}
+		T item;
+		size_t weight;
+	};
+public:
+	BlockingQueue(size_t maxItems, size_t maxWeight = std::numeric_limits<size_t>::max()) :
+	maxItems(maxItems),
+	maxWeight(maxWeight),
+	totalWeight(0),
+	items(),
+	closed(false),
+	queueMutex(),
+	notEmpty(),
+	notFull()
+	{
+		assert(maxItems > 0);
+	}
+	BlockingQueue(const BlockingQueue& other) = delete;
+	BlockingQueue& operator=(const BlockingQueue& other) = delete;
+	bool push(T item, size_t weight = 1)
+	{
+		{
+			std::unique_lock<std::mutex> lock { queueMutex };
+			notFull.wait(lock, [this, weight]() { return closed || items.size() == 0 || (items.size() < maxItems && totalWeight + weight <= maxWeight); });
+			if (closed) return false;
+			items.emplace_back(std::move(item), weight);
+			totalWeight += weight;
+		}
+		notEmpty.notify_one();
+		return true;
+	}
+	//moves at least one and at most maxCount items to the end of result
+	//stops early once the popped items weigh maxWeight or more
+	size_t popBatch(std::vector<T>& result, size_t maxCount, size_t maxWeight = std::numeric_limits<size_t>::max())
+	{
+		assert(maxCount > 0);
+		size_t popped = 0;
+		{
+			std::unique_lock<std::mutex> lock { queueMutex };
+			notEmpty.wait(lock, [this]() { return closed || items.size() > 0; });
+			size_t poppedWeight = 0;
+			while (items.size() > 0 && popped < maxCount && poppedWeight < maxWeight)
+			{
+				poppedWeight += items.front().weight;
+				totalWeight -= items.front().weight;
+				result.emplace_back(std::move(items.front().item));
+				items.pop_front();
+				popped += 1;
+			}
+		}
+		if (popped > 0) notFull.notify_all();
+		return popped;
+	}
+	void close()
+	{
+		{
+			std::lock_guard<std::mutex> lock { queueMutex };
+			closed = true;
+		}
+		notEmpty.notify_all();
+		notFull.notify_all();
+	}
+	size_t size() const
+	{
+		std::lock_guard<std::mutex> lock { queueMutex };
+		return items.size();
+	}
+private:
+	size_t maxItems;
+	size_t maxWeight;
+	size_t totalWeight;
+	std::deque<WeightedItem> items;
+	bool closed;
+	mutable std::mutex queueMutex;
+	std::condition_variable notEmpty;
+	std::condition_variable notFull;
+};
+
+#endif
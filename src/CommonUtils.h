@@ -12,6 +12,11 @@ namespace CommonUtils
 	struct InvalidGraphException : std::runtime_error
 	{
 		InvalidGraphException(const char* c);
+		InvalidGraphException(const std::string& c);
+	};
+	struct InvalidReadFileException : std::runtime_error
+	{
+		InvalidReadFileException(const std::string& c);
 	};
 	namespace inner
 	{
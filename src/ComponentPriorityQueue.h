@@ -1,9 +1,15 @@
 #ifndef ComponentPriorityQueue_h
 #define ComponentPriorityQueue_h
 
-#include <queue>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
 #include "ThreadReadAssertion.h"
+#include "PagedArray.h"
 
+//radix heap on the component, items of the same component are popped in the order of their score
+//an item's out-neighbors are in the same or a later component, so keys are never inserted below the last popped component
+//each node has at most one item in the heap, and the extras of the nodes in the heap are kept in a pool of reused vectors
 template <typename T>
 class ComponentPriorityQueue
 {
@@ -13,48 +19,57 @@ class ComponentPriorityQueue
 		size_t component;
 		int score;
 		size_t index;
-		bool operator<(const PrioritizedItem& other) const { return component < other.component || (component == other.component && score < other.score); }
-		bool operator>(const PrioritizedItem& other) const { return component > other.component || (component == other.component && score > other.score); }
 	};
+	struct ScoreGreater
+	{
+		bool operator()(const PrioritizedItem& left, const PrioritizedItem& right) const { return left.score > right.score; }
+	};
+	//bucket 0 holds the items of the last popped component, bucket i the items whose component differs from it first at bit i-1
+	static constexpr size_t NumBuckets = sizeof(size_t) * 8 + 1;
 public:
 	ComponentPriorityQueue(size_t maxNode) :
-	activeQueues(),
-	active(),
-	extras()
+	buckets(NumBuckets),
+	numItems(0),
+	lastComponent(0),
+	extraSlot(maxNode),
+	extraPool(),
+	freeSlots(),
+	emptyExtras()
 	{
-		active.resize(maxNode, false);
-		extras.resize(maxNode);
 	}
 #ifdef NDEBUG
 	__attribute__((always_inline))
 #endif
 	T& top()
 	{
-		assert(activeQueues.size() > 0);
-		auto index = activeQueues.top().index;
-		assert(active[index]);
-		assert(extras[index].size() > 0);
-		return extras[index][0];
+		assert(numItems > 0);
+		if (buckets[0].size() == 0) refillFirstBucket();
+		auto index = buckets[0][0].index;
+		assert(slotOf(index) != 0);
+		assert(extraPool[slotOf(index)-1].size() > 0);
+		return extraPool[slotOf(index)-1][0];
 	}
 #ifdef NDEBUG
 	__attribute__((always_inline))
 #endif
 	void pop()
 	{
-		assert(activeQueues.size() > 0);
-		size_t index = activeQueues.top().index;
-		assert(active[index]);
-		assert(extras[index].size() > 0);
-		extras[index].clear();
-		active[index] = false;
-		activeQueues.pop();
+		assert(numItems > 0);
+		if (buckets[0].size() == 0) refillFirstBucket();
+		size_t index = buckets[0][0].index;
+		std::pop_heap(buckets[0].begin(), buckets[0].end(), ScoreGreater{});
+		buckets[0].pop_back();
+		releaseSlot(index);
+		numItems--;
+		//every key is valid again once the queue is empty
+		if (numItems == 0) lastComponent = 0;
 	}
 #ifdef NDEBUG
 	__attribute__((always_inline))
 #endif
 	size_t size() const
 	{
-		return activeQueues.size();
+		return numItems;
 	}
 	void insert(size_t component, const T& item)
 	{
@@ -66,53 +81,130 @@ public:
 	void insert(size_t component, int score, const T& item)
 	{
 		size_t index = getId(item);
-		assert(index < extras.size());
-		if (!active[index])
+		assert(index < extraSlot.size());
+		size_t slot = slotOf(index);
+		if (slot == 0)
 		{
-			assert(extras[index].size() == 0);
-			activeQueues.emplace(component, score, index);
-			active[index] = true;
+			slot = allocateSlot();
+			extraSlot[index] = slot;
+			pushItem(PrioritizedItem { component, score, index });
+			numItems++;
 		}
-		extras[index].push_back(item);
+		extraPool[slot-1].push_back(item);
 	}
 	void clear()
 	{
-		while (activeQueues.size() > 0)
+		for (auto& bucket : buckets)
 		{
-			size_t index = activeQueues.top().index;
-			assert(active[index]);
-			removeExtras(index);
-			active[index] = false;
-			activeQueues.pop();
+			for (auto item : bucket)
+			{
+				releaseSlot(item.index);
+			}
+			bucket.clear();
 		}
+		numItems = 0;
+		lastComponent = 0;
 	}
 	const std::vector<T>& getExtras(size_t index) const
 	{
-		assert(index < extras.size());
-		return extras[index];
+		assert(index < extraSlot.size());
+		size_t slot = slotOf(index);
+		if (slot == 0) return emptyExtras;
+		return extraPool[slot-1];
 	}
 	void removeExtras(size_t index)
 	{
-		assert(index < extras.size());
-		extras[index].clear();
+		assert(index < extraSlot.size());
+		size_t slot = slotOf(index);
+		if (slot == 0) return;
+		extraPool[slot-1].clear();
 	}
 	size_t extraSize(size_t index) const
 	{
-		assert(index < extras.size());
-		return extras[index].size();
+		return getExtras(index).size();
 	}
 	bool valid() const
 	{
-		return active.size() > 0;
+		return extraSlot.size() > 0;
 	}
 private:
 	size_t getId(const T& item) const
 	{
 		return item.target;
 	}
-	std::priority_queue<PrioritizedItem, std::vector<PrioritizedItem>, std::greater<PrioritizedItem>> activeQueues;
-	std::vector<bool> active;
-	std::vector<std::vector<T>> extras;
+	size_t bucketIndex(size_t component) const
+	{
+		assert(component >= lastComponent);
+		if (component == lastComponent) return 0;
+		return sizeof(unsigned long long) * 8 - __builtin_clzll((unsigned long long)(component ^ lastComponent));
+	}
+	void pushItem(PrioritizedItem item)
+	{
+		size_t bucket = bucketIndex(item.component);
+		buckets[bucket].push_back(item);
+		if (bucket == 0) std::push_heap(buckets[0].begin(), buckets[0].end(), ScoreGreater{});
+	}
+	//moves the items of the smallest remaining component to the first bucket
+	void refillFirstBucket()
+	{
+		assert(buckets[0].size() == 0);
+		size_t bucket = 1;
+		while (buckets[bucket].size() == 0)
+		{
+			bucket++;
+			assert(bucket < NumBuckets);
+		}
+		size_t minComponent = buckets[bucket][0].component;
+		for (auto item : buckets[bucket])
+		{
+			minComponent = std::min(minComponent, item.component);
+		}
+		lastComponent = minComponent;
+		std::vector<PrioritizedItem> moved;
+		std::swap(moved, buckets[bucket]);
+		for (auto item : moved)
+		{
+			size_t newBucket = bucketIndex(item.component);
+			assert(newBucket < bucket);
+			buckets[newBucket].push_back(item);
+		}
+		moved.clear();
+		//keep the capacity of the emptied bucket
+		std::swap(moved, buckets[bucket]);
+		std::make_heap(buckets[0].begin(), buckets[0].end(), ScoreGreater{});
+	}
+	size_t slotOf(size_t index) const
+	{
+		return extraSlot[index];
+	}
+	size_t allocateSlot()
+	{
+		if (freeSlots.size() > 0)
+		{
+			size_t slot = freeSlots.back();
+			freeSlots.pop_back();
+			return slot;
+		}
+		extraPool.emplace_back();
+		return extraPool.size();
+	}
+	void releaseSlot(size_t index)
+	{
+		size_t slot = slotOf(index);
+		assert(slot != 0);
+		extraPool[slot-1].clear();
+		freeSlots.push_back(slot);
+		extraSlot.release(index);
+	}
+	std::vector<std::vector<PrioritizedItem>> buckets;
+	size_t numItems;
+	size_t lastComponent;
+	//one-based index of the node's extras in the pool, zero if the node is not in the heap
+	//paged so the per-thread queues only take memory for the parts of the graph the thread has aligned to
+	PagedArray<uint32_t> extraSlot;
+	std::vector<std::vector<T>> extraPool;
+	std::vector<uint32_t> freeSlots;
+	std::vector<T> emptyExtras;
 };
 
 #endif
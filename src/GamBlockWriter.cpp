@@ -0,0 +1,126 @@
+#include <cstring>
+#include <stdexcept>
+#include "GamBlockWriter.h"
+
+//a group is compressed once it has this many alignments or this many uncompressed bytes
+const size_t GamBlockMaxAlignments = 1000;
+const size_t GamBlockMaxBytes = 1024 * 1024;
+
+namespace
+{
+	void appendVarint(std::string& target, uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			target.push_back((char)((value & 0x7F) | 0x80));
+			value >>= 7;
+		}
+		target.push_back((char)value);
+	}
+}
+
+SerializedAlignments::SerializedAlignments() :
+data(),
+count(0),
+message()
+{
+}
+
+void SerializedAlignments::add(const vg::Alignment& alignment)
+{
+	alignment.SerializeToString(&message);
+	appendVarint(data, message.size());
+	data.append(message);
+	count += 1;
+}
+
+void SerializedAlignments::clear()
+{
+	data.clear();
+	count = 0;
+}
+
+BufferPool::BufferPool() :
+poolMutex(),
+buffers()
+{
+}
+
+std::string BufferPool::get()
+{
+	std::lock_guard<std::mutex> lock { poolMutex };
+	if (buffers.size() == 0) return std::string {};
+	std::string result = std::move(buffers.back());
+	buffers.pop_back();
+	result.clear();
+	return result;
+}
+
+void BufferPool::release(std::string&& buffer)
+{
+	std::lock_guard<std::mutex> lock { poolMutex };
+	buffers.emplace_back(std::move(buffer));
+}
+
+GamBlockCompressor::GamBlockCompressor(BufferPool& pool) :
+pool(pool),
+stream(),
+group()
+{
+	memset(&stream, 0, sizeof(stream));
+	//16 writes a gzip header
+	if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) throw std::runtime_error { "Could not initialize zlib" };
+	group.data.reserve(GamBlockMaxBytes);
+}
+
+GamBlockCompressor::~GamBlockCompressor()
+{
+	deflateEnd(&stream);
+}
+
+void GamBlockCompressor::add(const vg::Alignment& alignment)
+{
+	group.add(alignment);
+}
+
+bool GamBlockCompressor::full() const
+{
+	return group.count >= GamBlockMaxAlignments || group.data.size() >= GamBlockMaxBytes;
+}
+
+bool GamBlockCompressor::empty() const
+{
+	return group.count == 0;
+}
+
+std::string GamBlockCompressor::compress()
+{
+	std::string header;
+	appendVarint(header, group.count);
+	std::string result = pool.get();
+	result.resize(deflateBound(&stream, header.size() + group.data.size()));
+	size_t resultSize = 0;
+	deflateReset(&stream);
+	deflateInto(result, resultSize, header.data(), header.size(), Z_NO_FLUSH);
+	deflateInto(result, resultSize, group.data.data(), group.data.size(), Z_FINISH);
+	result.resize(resultSize);
+	group.clear();
+	return result;
+}
+
+void GamBlockCompressor::deflateInto(std::string& output, size_t& outputSize, const char* data, size_t size, int flush)
+{
+	stream.next_in = (Bytef*)data;
+	stream.avail_in = size;
+	while (true)
+	{
+		if (outputSize == output.size()) output.resize(output.size() * 2 + 64);
+		stream.next_out = (Bytef*)(&output[0] + outputSize);
+		stream.avail_out = output.size() - outputSize;
+		int result = deflate(&stream, flush);
+		outputSize = output.size() - stream.avail_out;
+		if (result == Z_STREAM_END) break;
+		if (result != Z_OK && result != Z_BUF_ERROR) throw std::runtime_error { "Compression failed" };
+		if (flush != Z_FINISH && stream.avail_in == 0) break;
+	}
+}
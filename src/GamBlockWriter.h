@@ -0,0 +1,60 @@
+#ifndef GamBlockWriter_h
+#define GamBlockWriter_h
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <zlib.h>
+#include "vg.pb.h"
+
+//pool of reusable byte buffers so compressed blocks don't need to be reallocated for every write
+class BufferPool
+{
+public:
+	BufferPool();
+	BufferPool(const BufferPool& other) = delete;
+	BufferPool& operator=(const BufferPool& other) = delete;
+	//returns an empty buffer, possibly with capacity from an earlier use
+	std::string get();
+	void release(std::string&& buffer);
+private:
+	std::mutex poolMutex;
+	std::vector<std::string> buffers;
+};
+
+//length-prefixed serialized alignments, the body of a group in the vg stream format
+struct SerializedAlignments
+{
+	SerializedAlignments();
+	void add(const vg::Alignment& alignment);
+	void clear();
+	std::string data;
+	size_t count;
+private:
+	std::string message;
+};
+
+//collects alignments into a group and compresses the group into one gzip member
+//the members are in the vg stream format (count followed by length-prefixed messages) and can be concatenated into a .gam file
+class GamBlockCompressor
+{
+public:
+	GamBlockCompressor(BufferPool& pool);
+	~GamBlockCompressor();
+	GamBlockCompressor(const GamBlockCompressor& other) = delete;
+	GamBlockCompressor& operator=(const GamBlockCompressor& other) = delete;
+	void add(const vg::Alignment& alignment);
+	//the group has reached the block size limit and should be compressed
+	bool full() const;
+	bool empty() const;
+	//compresses the current group into a buffer from the pool and starts a new group
+	//an empty group produces a valid block with zero alignments
+	std::string compress();
+private:
+	void deflateInto(std::string& output, size_t& outputSize, const char* data, size_t size, int flush);
+	BufferPool& pool;
+	z_stream stream;
+	SerializedAlignments group;
+};
+
+#endif
@@ -5,6 +5,10 @@
 #include <algorithm>
 #include <string>
 #include <vector>
+#include <queue>
+#include <unordered_map>
+#include <set>
+#include <tuple>
 #include <iostream>
 #include "AlignmentGraph.h"
 #include "CommonUtils.h"
@@ -29,6 +33,28 @@ private:
 	mutable BufferedWriter logger;
 	using AlignerGraphsizedState = typename Common::AlignerGraphsizedState;
 	const Params& params;
+	//cells on the paths of the earlier extensions of a read, as graph node, diagonal and read block
+	//a seed on one of the diagonals close to such a cell in the read would repeat the dynamic programming of that extension
+	class ExtendedDiagonals
+	{
+	public:
+		void add(int nodeId, size_t nodeOffset, size_t seqPos)
+		{
+			cells.emplace(nodeId, (int64_t)nodeOffset - (int64_t)seqPos, seqPos / WordConfiguration<Word>::WordSize);
+		}
+		bool contains(int nodeId, size_t nodeOffset, size_t seqPos) const
+		{
+			int64_t diagonal = (int64_t)nodeOffset - (int64_t)seqPos;
+			size_t block = seqPos / WordConfiguration<Word>::WordSize;
+			for (size_t nearBlock = (block > 0 ? block - 1 : 0); nearBlock <= block + 1; nearBlock++)
+			{
+				if (cells.count(std::make_tuple(nodeId, diagonal, nearBlock)) == 1) return true;
+			}
+			return false;
+		}
+	private:
+		std::set<std::tuple<int, int64_t, size_t>> cells;
+	};
 public:
 
 	GraphAligner(const Params& params) :
@@ -66,17 +92,28 @@ public:
 		AlignmentResult result;
 		assert(seedHits.size() > 0);
 		// std::vector<std::tuple<size_t, size_t, size_t>> triedAlignmentNodes;
-		for (size_t i = 0; i < seedHits.size(); i++)
+		std::vector<SeedHit> chainedSeeds;
+		if (params.sloppyOptimizations)
+		{
+			//extend only one anchor per colinear chain of seeds, best chains first
+			chainedSeeds = chainSeeds(seedHits);
+			logger << seq_id << " " << seedHits.size() << " seeds chained into " << chainedSeeds.size() << " chains" << BufferedWriter::Flush;
+		}
+		const std::vector<SeedHit>& extendedSeeds = params.sloppyOptimizations ? chainedSeeds : seedHits;
+		//the seed of each alignment
+		std::vector<size_t> alignmentSeeds;
+		ExtendedDiagonals extended;
+		for (size_t i = 0; i < extendedSeeds.size(); i++)
 		{
-			std::string seedInfo = std::to_string(seedHits[i].nodeID) + (seedHits[i].reverse ? "-" : "+") + "," + std::to_string(seedHits[i].seqPos) + "," + std::to_string(seedHits[i].matchLen) + "," + std::to_string(seedHits[i].nodeOffset);
-			logger << seq_id << " seed " << i << "/" << seedHits.size() << " " << seedInfo;
+			std::string seedInfo = getSeedInfo(extendedSeeds[i]);
+			logger << seq_id << " seed " << i << "/" << extendedSeeds.size() << " " << seedInfo;
 			assertSetRead(seq_id, seedInfo);
 			if (params.sloppyOptimizations)
 			{
 				bool found = false;
 				for (auto aln : result.alignments)
 				{
-					if (aln.alignmentStart <= seedHits[i].seqPos && aln.alignmentEnd >= seedHits[i].seqPos)
+					if (aln.alignmentStart <= extendedSeeds[i].seqPos && aln.alignmentEnd >= extendedSeeds[i].seqPos)
 					{
 						logger << " skipped";
 						logger << BufferedWriter::Flush;
@@ -86,11 +123,43 @@ public:
 				}
 				if (found) continue;
 			}
+			else if (params.scoreOnlyFirstPass && params.joinExtendedSeeds && extended.contains(extendedSeeds[i].nodeID * 2 + (extendedSeeds[i].reverse ? 1 : 0), extendedSeeds[i].nodeOffset, extendedSeeds[i].seqPos))
+			{
+				//the seed is on the path of an earlier extension and would usually give the same alignment after selection, join it instead of extending again
+				logger << " joined";
+				logger << BufferedWriter::Flush;
+				continue;
+			}
 			logger << BufferedWriter::Flush;
 			result.seedsExtended += 1;
-			auto item = getAlignmentFromSeed(seq_id, sequence, seedHits[i], reusableState);
+			auto item = params.scoreOnlyFirstPass ? getAlignmentSpanFromSeed(seq_id, sequence, extendedSeeds[i], extended, reusableState) : getAlignmentFromSeed(seq_id, sequence, extendedSeeds[i], reusableState);
 			if (item.alignmentFailed()) continue;
 			result.alignments.push_back(item);
+			alignmentSeeds.push_back(i);
+		}
+		if (params.scoreOnlyFirstPass && result.alignments.size() > 0)
+		{
+			//selection only looks at the scores and spans, so only the selected alignments need the backtrace
+			std::vector<size_t> candidates;
+			for (size_t i = 0; i < result.alignments.size(); i++)
+			{
+				candidates.push_back(i);
+			}
+			auto selected = CommonUtils::SelectAlignments(candidates, std::numeric_limits<size_t>::max(), [&result](size_t index) { return result.alignments[index].alignment.get(); });
+			std::vector<AlignmentResult::AlignmentItem> traced;
+			for (auto index : selected)
+			{
+				const SeedHit& seed = extendedSeeds[alignmentSeeds[index]];
+				logger << seq_id << " backtrace seed " << alignmentSeeds[index] << "/" << extendedSeeds.size() << BufferedWriter::Flush;
+				assertSetRead(seq_id, getSeedInfo(seed));
+				auto item = getAlignmentFromSeed(seq_id, sequence, seed, reusableState);
+				assert(item.alignmentStart == result.alignments[index].alignmentStart);
+				assert(item.alignmentEnd == result.alignments[index].alignmentEnd);
+				assert(item.alignment->score() == result.alignments[index].alignment->score());
+				if (item.alignmentFailed()) continue;
+				traced.push_back(item);
+			}
+			result.alignments = std::move(traced);
 		}
 		assertSetRead(seq_id, "No seed");
 
@@ -99,6 +168,136 @@ public:
 
 private:
 
+	//distances from a position to the starts of the nodes reachable from it, up to maxDistance
+	std::unordered_map<size_t, size_t> nodeDistancesFrom(size_t node, size_t offset, size_t maxDistance) const
+	{
+		//a limit for tangled areas where the bounded search would still explore too much
+		const size_t MaxVisitedNodes = 10000;
+		std::unordered_map<size_t, size_t> result;
+		std::priority_queue<std::pair<size_t, size_t>, std::vector<std::pair<size_t, size_t>>, std::greater<std::pair<size_t, size_t>>> queue;
+		size_t distanceToEnd = params.graph.NodeLength(node) - offset;
+		if (distanceToEnd > maxDistance) return result;
+		for (auto neighbor : params.graph.outNeighbors[node])
+		{
+			queue.emplace(distanceToEnd, neighbor);
+		}
+		while (queue.size() > 0 && result.size() < MaxVisitedNodes)
+		{
+			auto top = queue.top();
+			queue.pop();
+			if (result.count(top.second) == 1) continue;
+			result[top.second] = top.first;
+			size_t nextDistance = top.first + params.graph.NodeLength(top.second);
+			if (nextDistance > maxDistance) continue;
+			for (auto neighbor : params.graph.outNeighbors[top.second])
+			{
+				if (result.count(neighbor) == 0) queue.emplace(nextDistance, neighbor);
+			}
+		}
+		return result;
+	}
+
+	//groups seeds which are colinear in the read and in the graph into chains and returns one anchor seed per chain, best chains first
+	//the chain score is the number of read bases covered by the seeds minus the differences between the read and graph distances
+	std::vector<SeedHit> chainSeeds(const std::vector<SeedHit>& seedHits) const
+	{
+		//each seed is compared to at most this many earlier seeds in the read
+		const size_t MaxPredecessors = 50;
+		//seeds further than this apart in the read are not chained
+		const size_t MaxChainGap = 10000;
+		//allowed difference between the read and graph distances, as a minimum and as a fraction of the read distance
+		const size_t MinDiagonalDifference = 50;
+		const size_t DiagonalDifferenceDivisor = 5;
+		std::vector<size_t> order;
+		std::vector<size_t> seedNode;
+		std::vector<size_t> seedOffset;
+		order.reserve(seedHits.size());
+		seedNode.reserve(seedHits.size());
+		seedOffset.reserve(seedHits.size());
+		for (size_t i = 0; i < seedHits.size(); i++)
+		{
+			int directedNodeId = seedHits[i].nodeID * 2 + (seedHits[i].reverse ? 1 : 0);
+			size_t node = params.graph.GetUnitigNode(directedNodeId, seedHits[i].nodeOffset);
+			order.push_back(i);
+			seedNode.push_back(node);
+			seedOffset.push_back(seedHits[i].nodeOffset - params.graph.nodeOffset[node]);
+		}
+		std::stable_sort(order.begin(), order.end(), [&seedHits](size_t left, size_t right) { return seedHits[left].seqPos < seedHits[right].seqPos; });
+		std::vector<long long> score;
+		std::vector<size_t> predecessor;
+		score.resize(order.size());
+		predecessor.resize(order.size(), std::numeric_limits<size_t>::max());
+		for (size_t j = 0; j < order.size(); j++)
+		{
+			score[j] = seedHits[order[j]].matchLen;
+		}
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			const SeedHit& from = seedHits[order[i]];
+			size_t lastCandidate = i + 1;
+			while (lastCandidate < order.size() && lastCandidate <= i + MaxPredecessors && seedHits[order[lastCandidate]].seqPos - from.seqPos <= MaxChainGap) lastCandidate++;
+			if (lastCandidate == i + 1) continue;
+			size_t maxReadDistance = seedHits[order[lastCandidate-1]].seqPos - from.seqPos;
+			auto distances = nodeDistancesFrom(seedNode[order[i]], seedOffset[order[i]], maxReadDistance + std::max(MinDiagonalDifference, maxReadDistance / DiagonalDifferenceDivisor));
+			for (size_t j = i + 1; j < lastCandidate; j++)
+			{
+				const SeedHit& to = seedHits[order[j]];
+				size_t readDistance = to.seqPos - from.seqPos;
+				if (readDistance == 0) continue;
+				size_t graphDistance;
+				if (seedNode[order[j]] == seedNode[order[i]] && seedOffset[order[j]] >= seedOffset[order[i]])
+				{
+					graphDistance = seedOffset[order[j]] - seedOffset[order[i]];
+				}
+				else
+				{
+					auto found = distances.find(seedNode[order[j]]);
+					if (found == distances.end()) continue;
+					graphDistance = found->second + seedOffset[order[j]];
+				}
+				size_t diagonalDifference = graphDistance > readDistance ? graphDistance - readDistance : readDistance - graphDistance;
+				if (diagonalDifference > std::max(MinDiagonalDifference, readDistance / DiagonalDifferenceDivisor)) continue;
+				size_t fromEnd = from.seqPos + from.matchLen;
+				size_t toEnd = to.seqPos + to.matchLen;
+				size_t newCoverage = toEnd > fromEnd ? std::min(to.matchLen, toEnd - fromEnd) : 0;
+				long long chainedScore = score[i] + (long long)newCoverage - (long long)diagonalDifference;
+				if (chainedScore > score[j])
+				{
+					score[j] = chainedScore;
+					predecessor[j] = i;
+				}
+			}
+		}
+		std::vector<size_t> chainEnds;
+		chainEnds.reserve(order.size());
+		for (size_t j = 0; j < order.size(); j++)
+		{
+			chainEnds.push_back(j);
+		}
+		std::stable_sort(chainEnds.begin(), chainEnds.end(), [&score](size_t left, size_t right) { return score[left] > score[right]; });
+		std::vector<bool> used;
+		used.resize(order.size(), false);
+		std::vector<SeedHit> result;
+		for (auto end : chainEnds)
+		{
+			if (used[end]) continue;
+			//the anchor is the longest seed in the chain, stopping at seeds which belong to a better chain
+			size_t anchor = end;
+			for (size_t pos = end; pos != std::numeric_limits<size_t>::max() && !used[pos]; pos = predecessor[pos])
+			{
+				used[pos] = true;
+				if (seedHits[order[pos]].matchLen > seedHits[order[anchor]].matchLen) anchor = pos;
+			}
+			result.push_back(seedHits[order[anchor]]);
+		}
+		return result;
+	}
+
+	std::string getSeedInfo(const SeedHit& seed) const
+	{
+		return std::to_string(seed.nodeID) + (seed.reverse ? "-" : "+") + "," + std::to_string(seed.seqPos) + "," + std::to_string(seed.matchLen) + "," + std::to_string(seed.nodeOffset);
+	}
+
 	OnewayTrace getBacktraceFullStart(const std::string& sequence, AlignerGraphsizedState& reusableState) const
 	{
 		return bvAligner.getBacktraceFullStart(sequence, reusableState);
@@ -172,7 +371,7 @@ private:
 			trace[i].first.seqPos = end - trace[i].first.seqPos;
 			size_t offset = params.graph.nodeOffset[trace[i].first.node] + trace[i].first.nodeOffset;
 			auto reversePos = params.graph.GetReversePosition(params.graph.nodeIDs[trace[i].first.node], offset);
-			assert(reversePos.second < params.graph.originalNodeSize.at(params.graph.nodeIDs[trace[i].first.node]));
+			assert(reversePos.second < params.graph.OriginalNodeSize(params.graph.nodeIDs[trace[i].first.node]));
 			trace[i].first.node = reversePos.first;
 			trace[i].first.nodeOffset = reversePos.second;
 		}
@@ -241,6 +440,83 @@ private:
 		return result;
 	}
 
+	//extends both ways from the seed without the backtrace. the alignment has only the score, the sequence and the query position,
+	//which is what alignment selection looks at. the score and span are the same as the alignment from getAlignmentFromSeed would have
+	//there is no path, so the seed and the minimum score cells at the slice boundaries of a successful extension are added to extended as its cells
+	AlignmentResult::AlignmentItem getAlignmentSpanFromSeed(const std::string& seq_id, const std::string& sequence, SeedHit seedHit, ExtendedDiagonals& extended, AlignerGraphsizedState& reusableState) const
+	{
+		assert(params.graph.finalized);
+		assert(seedHit.seqPos >= 0);
+		assert(seedHit.seqPos < sequence.size());
+		auto timeStart = std::chrono::system_clock::now();
+		int forwardNodeId = seedHit.nodeID * 2 + (seedHit.reverse ? 1 : 0);
+		int backwardNodeId = seedHit.nodeID * 2 + (seedHit.reverse ? 0 : 1);
+		std::pair<ScoreType, size_t> backward { std::numeric_limits<ScoreType>::max(), 0 };
+		std::pair<ScoreType, size_t> forward { std::numeric_limits<ScoreType>::max(), 0 };
+		std::vector<MatrixPosition> backwardMinimums;
+		std::vector<MatrixPosition> forwardMinimums;
+		if (seedHit.seqPos > 0)
+		{
+			auto backwardPart = CommonUtils::ReverseComplement(sequence.substr(0, seedHit.seqPos));
+			auto reversePos = params.graph.GetReversePosition(forwardNodeId, seedHit.nodeOffset);
+			assert(reversePos.first == backwardNodeId);
+			backward = bvAligner.getScoreFromSeed(backwardPart, backwardNodeId, reversePos.second, backwardMinimums, reusableState);
+		}
+		if (seedHit.seqPos < sequence.size()-1)
+		{
+			forward = bvAligner.getScoreFromSeed(sequence.substr(seedHit.seqPos+1), forwardNodeId, seedHit.nodeOffset, forwardMinimums, reusableState);
+		}
+		bool backwardFailed = backward.first == std::numeric_limits<ScoreType>::max();
+		bool forwardFailed = forward.first == std::numeric_limits<ScoreType>::max();
+		//failed alignment, don't output
+		if (backwardFailed && forwardFailed)
+		{
+			return VGAlignment::emptyAlignment(0, 0);
+		}
+		//only the directions which were extended are recorded, so a failed extension doesn't stop later seeds on its diagonals
+		extended.add(forwardNodeId, seedHit.nodeOffset, seedHit.seqPos);
+		if (!backwardFailed)
+		{
+			for (auto pos : backwardMinimums)
+			{
+				auto reversePos = params.graph.GetReversePosition(params.graph.nodeIDs[pos.node], params.graph.nodeOffset[pos.node] + pos.nodeOffset);
+				extended.add(reversePos.first, reversePos.second, seedHit.seqPos - 1 - pos.seqPos);
+			}
+		}
+		if (!forwardFailed)
+		{
+			for (auto pos : forwardMinimums)
+			{
+				extended.add(params.graph.nodeIDs[pos.node], params.graph.nodeOffset[pos.node] + pos.nodeOffset, seedHit.seqPos + 1 + pos.seqPos);
+			}
+		}
+		ScoreType score = 0;
+		LengthType seqstart = seedHit.seqPos;
+		LengthType seqend = seedHit.seqPos;
+		if (!backwardFailed)
+		{
+			score += backward.first;
+			seqstart = seedHit.seqPos - 1 - backward.second;
+		}
+		if (!forwardFailed)
+		{
+			score += forward.first;
+			seqend = seedHit.seqPos + 1 + forward.second;
+		}
+		assert(seqend < sequence.size());
+		auto alignment = std::make_shared<vg::Alignment>();
+		alignment->set_name(seq_id);
+		alignment->set_score(score);
+		alignment->set_sequence(sequence.substr(seqstart, seqend - seqstart + 1));
+		alignment->set_query_position(seqstart);
+		auto timeEnd = std::chrono::system_clock::now();
+		size_t time = std::chrono::duration_cast<std::chrono::milliseconds>(timeEnd - timeStart).count();
+		AlignmentResult::AlignmentItem result { alignment, 0, time };
+		result.alignmentStart = seqstart;
+		result.alignmentEnd = seqend + 1;
+		return result;
+	}
+
 	// void addAlignmentNodes(std::vector<std::tuple<size_t, size_t, size_t>>& tried, const AlignmentResult::AlignmentItem& trace) const
 	// {
 	// 	assert(trace.trace.size() > 0);
@@ -55,7 +55,7 @@ private:
 		,numCells(0)
 #endif
 		{}
-		DPSlice(std::vector<typename NodeSlice<LengthType, ScoreType, Word, true>::MapItem>* vectorMap) :
+		DPSlice(typename NodeSlice<LengthType, ScoreType, Word, true>::VectorMapType* vectorMap) :
 		minScore(std::numeric_limits<ScoreType>::max()),
 		minScoreNode(std::numeric_limits<LengthType>::max()),
 		minScoreNodeOffset(std::numeric_limits<LengthType>::max()),
@@ -124,7 +124,7 @@ public:
 	{
 		size_t numSlices = (sequence.size() + WordConfiguration<Word>::WordSize - 1) / WordConfiguration<Word>::WordSize;
 		auto initialBandwidth = getInitialSliceExactPosition(bigraphNodeId, nodeOffset);
-		auto slice = getSqrtSlices(sequence, initialBandwidth, numSlices, reusableState);
+		auto slice = getSqrtSlices(sequence, initialBandwidth, numSlices, checkpointInterval(numSlices), reusableState);
 		removeWronglyAlignedEnd(slice);
 		if (slice.slices.size() <= 1)
 		{
@@ -141,6 +141,26 @@ public:
 		return result;
 	}
 
+	//the score and the last aligned position in the sequence of the extension from the seed, without the backtrace
+	//no slice keeps its scores so the memory use doesn't depend on the sequence length. the score is max if the extension failed
+	//the minimum score cell of the last row of each slice is added to sliceMinimums
+	std::pair<ScoreType, size_t> getScoreFromSeed(const std::string& sequence, int bigraphNodeId, size_t nodeOffset, std::vector<MatrixPosition>& sliceMinimums, AlignerGraphsizedState& reusableState) const
+	{
+		size_t numSlices = (sequence.size() + WordConfiguration<Word>::WordSize - 1) / WordConfiguration<Word>::WordSize;
+		auto initialBandwidth = getInitialSliceExactPosition(bigraphNodeId, nodeOffset);
+		auto slice = getSqrtSlices(sequence, initialBandwidth, numSlices, std::numeric_limits<size_t>::max(), reusableState);
+		removeWronglyAlignedEnd(slice);
+		if (slice.slices.size() <= 1)
+		{
+			return std::make_pair(std::numeric_limits<ScoreType>::max(), 0);
+		}
+		for (size_t i = 1; i < slice.slices.size(); i++)
+		{
+			sliceMinimums.emplace_back(slice.slices[i].minScoreNode, slice.slices[i].minScoreNodeOffset, std::min<size_t>(slice.slices[i].j + WordConfiguration<Word>::WordSize - 1, sequence.size()-1));
+		}
+		return std::make_pair(slice.slices.back().minScore, std::min<size_t>(slice.slices.back().j + WordConfiguration<Word>::WordSize - 1, sequence.size()-1));
+	}
+
 	OnewayTrace getBacktraceFullStart(std::string originalSequence, AlignerGraphsizedState& reusableState) const
 	{
 		assert(originalSequence.size() > 1);
@@ -180,7 +200,7 @@ public:
 		std::string alignableSequence = originalSequence.substr(1);
 		assert(alignableSequence.size() > 0);
 		size_t numSlices = (alignableSequence.size() + WordConfiguration<Word>::WordSize - 1) / WordConfiguration<Word>::WordSize;
-		auto slice = getSqrtSlices(alignableSequence, startSlice, numSlices, reusableState);
+		auto slice = getSqrtSlices(alignableSequence, startSlice, numSlices, checkpointInterval(numSlices), reusableState);
 		removeWronglyAlignedEnd(slice);
 		if (slice.slices.size() <= 1)
 		{
@@ -199,21 +219,36 @@ public:
 
 private:
 
-	OnewayTrace getReverseTraceFromTable(const std::string& sequence, const DPTable& slice, AlignerGraphsizedState& reusableState) const
+	OnewayTrace getReverseTraceFromTable(const std::string& sequence, DPTable& slice, AlignerGraphsizedState& reusableState) const
 	{
 		assert(slice.slices.size() > 0);
 		assert(slice.slices.back().minScoreNode != std::numeric_limits<LengthType>::max());
 		assert(slice.slices.back().minScoreNodeOffset != std::numeric_limits<LengthType>::max());
 		OnewayTrace result;
 		result.score = slice.slices.back().minScore;
-		result.trace.emplace_back(MatrixPosition {slice.slices.back().minScoreNode, slice.slices.back().minScoreNodeOffset, std::min(slice.slices.back().j + WordConfiguration<Word>::WordSize - 1, sequence.size()-1)}, false);
+		result.trace.emplace_back(MatrixPosition {slice.slices.back().minScoreNode, slice.slices.back().minScoreNodeOffset, std::min<size_t>(slice.slices.back().j + WordConfiguration<Word>::WordSize - 1, sequence.size()-1)}, false);
 		LengthType currentNode = std::numeric_limits<LengthType>::max();
 		size_t currentSlice = slice.slices.size();
 		std::vector<WordSlice> nodeSlices;
+		//the slices between checkpoints which are currently recomputed
+		size_t recomputedStart = 0;
+		size_t recomputedEnd = 0;
 		while (result.trace.back().first.seqPos != (size_t)-1)
 		{
 			size_t newSlice = result.trace.back().first.seqPos / WordConfiguration<Word>::WordSize + 1;
 			assert(newSlice < slice.slices.size());
+			if (newSlice != currentSlice && (!slice.slices[newSlice].scores.hasNodeMapCurrently() || !slice.slices[newSlice-1].scores.hasNodeMapCurrently()))
+			{
+				for (size_t i = recomputedStart; i < recomputedEnd; i++)
+				{
+					slice.slices[i].scores.removeNodeMap();
+				}
+				recomputedStart = newSlice;
+				while (!slice.slices[recomputedStart-1].scores.hasNodeMapCurrently()) recomputedStart--;
+				recomputedEnd = newSlice;
+				while (recomputedEnd < slice.slices.size() && !slice.slices[recomputedEnd].scores.hasNodeMapCurrently()) recomputedEnd++;
+				recomputeSlices(sequence, slice, recomputedStart, recomputedEnd, reusableState);
+			}
 			assert(result.trace.back().first.seqPos >= slice.slices[newSlice].j);
 			assert(result.trace.back().first.seqPos < slice.slices[newSlice].j + WordConfiguration<Word>::WordSize);
 			LengthType newNode = result.trace.back().first.node;
@@ -683,7 +718,7 @@ private:
 	__attribute__((always_inline))
 #endif
 	template <typename NodeChunkType>
-	NodeCalculationResult calculateNode(size_t i, typename NodeSlice<LengthType, ScoreType, Word, true>::NodeSliceMapItem& slice, const EqVector& EqV, typename NodeSlice<LengthType, ScoreType, Word, true>::NodeSliceMapItem previousSlice, const std::vector<EdgeWithPriority>& incoming, const std::vector<bool>& previousBand, NodeChunkType nodeChunks) const
+	NodeCalculationResult calculateNode(size_t i, typename NodeSlice<LengthType, ScoreType, Word, true>::NodeSliceMapItem& slice, const EqVector& EqV, typename NodeSlice<LengthType, ScoreType, Word, true>::NodeSliceMapItem previousSlice, const std::vector<EdgeWithPriority>& incoming, const BandFlags& previousBand, NodeChunkType nodeChunks) const
 	{
 		assert(incoming.size() > 0);
 		WordSlice newWs;
@@ -870,7 +905,7 @@ private:
 				size_t fixoffset = 1;
 				for (size_t fixchunk = 0; fixchunk < slice.NUM_CHUNKS; fixchunk++)
 				{
-					for (; fixoffset < WordConfiguration<Word>::WordSize; fixoffset++)
+					for (; fixoffset < WordConfiguration<Word>::WordSize && fixchunk * WordConfiguration<Word>::WordSize + fixoffset < params.graph.SPLIT_NODE_SIZE; fixoffset++)
 					{
 						ScoreType newScoreComparison = scoreComparison;
 						newScoreComparison += (previousSlice.HP[fixchunk] >> fixoffset) & 1;
@@ -908,18 +943,19 @@ private:
 		if (!previousSlice.exists) forceEq ^= 1;
 		size_t smallChunk = 0;
 		size_t offset = 1;
-		pos = smallChunk * (WordConfiguration<Word>::WordSize / 2) + offset;
+		pos = smallChunk * params.graph.BP_IN_CHUNK + offset;
 		for (; smallChunk < params.graph.CHUNKS_IN_NODE; smallChunk++)
 		{
-			size_t bigChunk = smallChunk / 2;
-			size_t bigChunkOffset = (smallChunk % 2) * (WordConfiguration<Word>::WordSize / 2);
+			//the horizontal bitvectors have WordSize columns per word, the node sequence BP_IN_CHUNK columns per chunk
+			size_t bigChunk = smallChunk * params.graph.BP_IN_CHUNK / WordConfiguration<Word>::WordSize;
+			size_t bigChunkOffset = smallChunk * params.graph.BP_IN_CHUNK % WordConfiguration<Word>::WordSize;
 			Word HP = previousSlice.HP[bigChunk] >> bigChunkOffset;
 			Word HN = previousSlice.HN[bigChunk] >> bigChunkOffset;
 			auto charChunk = nodeChunks[smallChunk];
 			HP >>= offset;
 			HN >>= offset;
 			charChunk >>= offset * 2;
-			for (; offset < WordConfiguration<Word>::WordSize / 2 && pos < nodeLength; offset++)
+			for (; offset < params.graph.BP_IN_CHUNK && pos < nodeLength; offset++)
 			{
 				Eq = EqV.getEqI(charChunk & 3);
 				Eq &= forceEq;
@@ -960,7 +996,7 @@ private:
 	void assertBitvectorConfirmedAreConsistent(WordSlice newslice, WordSlice oldslice, ScoreType quitScore) const
 	{
 		assert(newslice.scoreBeforeStart <= oldslice.scoreBeforeStart);
-		for (int i = 0; i < 64; i++)
+		for (int i = 0; i < WordConfiguration<Word>::WordSize; i++)
 		{
 			auto newScore = newslice.getValue(i);
 			auto oldScore = oldslice.getValue(i);
@@ -1026,7 +1062,7 @@ private:
 #endif
 
 	template <bool HasVectorMap, bool PreviousHasVectorMap, typename PriorityQueue>
-	NodeCalculationResult calculateSlice(const std::string& sequence, size_t j, NodeSlice<LengthType, ScoreType, Word, HasVectorMap>& currentSlice, const NodeSlice<LengthType, ScoreType, Word, PreviousHasVectorMap>& previousSlice, std::vector<bool>& currentBand, const std::vector<bool>& previousBand, PriorityQueue& calculableQueue, ScoreType previousQuitScore, int bandwidth, ScoreType previousMinScore) const
+	NodeCalculationResult calculateSlice(const std::string& sequence, size_t j, NodeSlice<LengthType, ScoreType, Word, HasVectorMap>& currentSlice, const NodeSlice<LengthType, ScoreType, Word, PreviousHasVectorMap>& previousSlice, BandFlags& currentBand, const BandFlags& previousBand, PriorityQueue& calculableQueue, ScoreType previousQuitScore, int bandwidth, ScoreType previousMinScore) const
 	{
 		ScoreType currentMinimumScore = std::numeric_limits<ScoreType>::max() - bandwidth - 1;
 		LengthType currentMinimumNode = -1;
@@ -1039,7 +1075,7 @@ private:
 		EqVector EqV = BV::getEqVector(sequence, j);
 
 		assert(previousSlice.size() > 0);
-		ScoreType zeroScore = previousMinScore - j / 2 - 32;
+		ScoreType zeroScore = previousMinScore - j / 2 - WordConfiguration<Word>::WordSize / 2;
 		if (j == 0)
 		{
 			for (auto node : previousSlice)
@@ -1103,7 +1139,7 @@ private:
 			{
 				assert(!currentSlice.hasNode(i));
 				currentSlice.addNode(i);
-				currentBand[i] = true;
+				currentBand.set(i);
 			}
 			assert(currentBand[i]);
 			const std::vector<EdgeWithPriority>* extras;
@@ -1224,13 +1260,13 @@ private:
 	}
 
 	template <bool HasVectorMap>
-	void finalizeSlice(NodeSlice<LengthType, ScoreType, Word, HasVectorMap>& slice, std::vector<bool>& currentBand, ScoreType maxScore) const
+	void finalizeSlice(NodeSlice<LengthType, ScoreType, Word, HasVectorMap>& slice, BandFlags& currentBand, ScoreType maxScore) const
 	{
 		for (auto node : slice)
 		{
 			if (node.second.minScore > maxScore && node.second.endSlice.getMinScore() > maxScore)
 			{
-				currentBand[node.first] = false;
+				currentBand.unset(node.first);
 				slice.node(node.first).exists = false;
 			}
 		}
@@ -1289,7 +1325,7 @@ private:
 	}
 
 	template <typename PriorityQueue>
-	void fillDPSlice(const std::string& sequence, DPSlice& slice, const DPSlice& previousSlice, const std::vector<bool>& previousBand, std::vector<bool>& currentBand, PriorityQueue& calculableQueue, int bandwidth) const
+	void fillDPSlice(const std::string& sequence, DPSlice& slice, const DPSlice& previousSlice, const BandFlags& previousBand, BandFlags& currentBand, PriorityQueue& calculableQueue, int bandwidth) const
 	{
 		NodeCalculationResult sliceResult;
 		assert((ScoreType)previousSlice.bandwidth < std::numeric_limits<ScoreType>::max());
@@ -1332,7 +1368,7 @@ private:
 	}
 
 	template <typename PriorityQueue>
-	DPSlice pickMethodAndExtendFill(const std::string& sequence, const DPSlice& previous, const std::vector<bool>& previousBand, std::vector<bool>& currentBand, std::vector<typename NodeSlice<LengthType, ScoreType, Word, true>::MapItem>& nodesliceMap, PriorityQueue& calculableQueue, int bandwidth) const
+	DPSlice pickMethodAndExtendFill(const std::string& sequence, const DPSlice& previous, const BandFlags& previousBand, BandFlags& currentBand, typename NodeSlice<LengthType, ScoreType, Word, true>::VectorMapType& nodesliceMap, PriorityQueue& calculableQueue, int bandwidth) const
 	{
 		if (!params.lowMemory)
 		{
@@ -1365,10 +1401,17 @@ private:
 		}
 	}
 
-	DPTable getSqrtSlices(const std::string& sequence, const DPSlice& initialSlice, size_t numSlices, AlignerGraphsizedState& reusableState) const
+	//with checkpoints only every sqrt(n)th slice keeps its scores, the rest are recomputed during the backtrace
+	size_t checkpointInterval(size_t numSlices) const
+	{
+		return params.checkpointSlices ? std::max((size_t)1, (size_t)std::sqrt(numSlices)) : 1;
+	}
+
+	//only every checkpointInterval'th slice keeps its scores
+	DPTable getSqrtSlices(const std::string& sequence, const DPSlice& initialSlice, size_t numSlices, size_t checkpointInterval, AlignerGraphsizedState& reusableState) const
 	{
-		assert(initialSlice.j == (size_t)-WordConfiguration<Word>::WordSize);
-		assert(initialSlice.j + numSlices * WordConfiguration<Word>::WordSize <= sequence.size() + WordConfiguration<Word>::WordSize);
+		assert(initialSlice.j == (LengthType)-WordConfiguration<Word>::WordSize);
+		assert(numSlices * WordConfiguration<Word>::WordSize <= sequence.size() + 2 * WordConfiguration<Word>::WordSize);
 		DPTable result;
 		result.slices.reserve(numSlices + 1);
 		size_t cellsProcessed = 0;
@@ -1376,7 +1419,7 @@ private:
 		{
 			for (auto node : initialSlice.scores)
 			{
-				reusableState.previousBand[node.first] = true;
+				reusableState.previousBand.set(node.first);
 			}
 		}
 #ifndef NDEBUG
@@ -1446,12 +1489,12 @@ private:
 				for (auto node : lastSlice.scores)
 				{
 					assert(reusableState.previousBand[node.first]);
-					reusableState.previousBand[node.first] = false;
+					reusableState.previousBand.unset(node.first);
 				}
 				for (auto node : newSlice.scores)
 				{
 					assert(reusableState.currentBand[node.first]);
-					reusableState.currentBand[node.first] = false;
+					reusableState.currentBand.unset(node.first);
 				}
 				lastSlice.scoresVectorMap.removeVectorArray();
 				newSlice.scoresVectorMap.removeVectorArray();
@@ -1462,12 +1505,12 @@ private:
 				for (auto node : newSlice.scores)
 				{
 					assert(reusableState.currentBand[node.first]);
-					reusableState.currentBand[node.first] = false;
+					reusableState.currentBand.unset(node.first);
 				}
 				for (auto node : lastSlice.scores)
 				{
 					assert(reusableState.previousBand[node.first]);
-					reusableState.previousBand[node.first] = false;
+					reusableState.previousBand.unset(node.first);
 				}
 				lastSlice.scoresVectorMap.removeVectorArray();
 				newSlice.scoresVectorMap.removeVectorArray();
@@ -1477,7 +1520,7 @@ private:
 				for (auto node : lastSlice.scores)
 				{
 					assert(!reusableState.previousBand[node.first]);
-					reusableState.previousBand[node.first] = true;
+					reusableState.previousBand.set(node.first);
 				}
 				if (slice == (size_t)-1)
 				{
@@ -1500,10 +1543,14 @@ private:
 #endif
 
 			result.slices.push_back(newSlice.getMapSlice());
+			if (result.slices.size() >= 2 && (result.slices.size() - 2) % checkpointInterval != 0)
+			{
+				result.slices[result.slices.size() - 2].scores.removeNodeMap();
+			}
 			for (auto node : lastSlice.scores)
 			{
 				assert(reusableState.previousBand[node.first]);
-				reusableState.previousBand[node.first] = false;
+				reusableState.previousBand.unset(node.first);
 			}
 			assert(newSlice.minScore != std::numeric_limits<ScoreType>::max());
 			assert(newSlice.minScore >= lastSlice.minScore);
@@ -1512,7 +1559,7 @@ private:
 				for (auto node : newSlice.scores)
 				{
 					assert(reusableState.currentBand[node.first]);
-					reusableState.currentBand[node.first] = false;
+					reusableState.currentBand.unset(node.first);
 				}
 			}
 			else
@@ -1551,6 +1598,60 @@ private:
 		return result;
 	}
 
+	//fills the scores of slices [start, end) again from the stored slice start-1 with the same bandwidths as in the first fill
+	void recomputeSlices(const std::string& sequence, DPTable& table, size_t start, size_t end, AlignerGraphsizedState& reusableState) const
+	{
+		assert(start > 0);
+		assert(start < end);
+		assert(end <= table.slices.size());
+		assert(table.slices[start-1].scores.hasNodeMapCurrently());
+		DPSlice lastSlice = table.slices[start-1].getMapSlice();
+		for (auto node : lastSlice.scores)
+		{
+			assert(!reusableState.previousBand[node.first]);
+			reusableState.previousBand.set(node.first);
+		}
+		for (size_t slice = start; slice < end; slice++)
+		{
+#ifndef NDEBUG
+			debugLastRowMinScore = lastSlice.minScore;
+#endif
+			int bandwidth = table.slices[slice].bandwidth;
+			DPSlice newSlice;
+			if (reusableState.componentQueue.valid())
+			{
+				newSlice = pickMethodAndExtendFill(sequence, lastSlice, reusableState.previousBand, reusableState.currentBand, (slice % 2 == 0) ? reusableState.evenNodesliceMap : reusableState.oddNodesliceMap, reusableState.componentQueue, bandwidth);
+			}
+			else
+			{
+				newSlice = pickMethodAndExtendFill(sequence, lastSlice, reusableState.previousBand, reusableState.currentBand, (slice % 2 == 0) ? reusableState.evenNodesliceMap : reusableState.oddNodesliceMap, reusableState.calculableQueue, bandwidth);
+			}
+			assert(newSlice.j == table.slices[slice].j);
+			assert(newSlice.minScore == table.slices[slice].minScore);
+			table.slices[slice].scores = newSlice.scores;
+			for (auto node : lastSlice.scores)
+			{
+				assert(reusableState.previousBand[node.first]);
+				reusableState.previousBand.unset(node.first);
+			}
+			if (slice == end - 1)
+			{
+				for (auto node : newSlice.scores)
+				{
+					assert(reusableState.currentBand[node.first]);
+					reusableState.currentBand.unset(node.first);
+				}
+			}
+			else
+			{
+				std::swap(reusableState.previousBand, reusableState.currentBand);
+			}
+			lastSlice.scoresVectorMap.removeVectorArray();
+			lastSlice = std::move(newSlice);
+		}
+		lastSlice.scoresVectorMap.removeVectorArray();
+	}
+
 	DPSlice getInitialSliceExactPosition(LengthType bigraphNodeId, size_t offset) const
 	{
 		DPSlice result;
@@ -1558,8 +1659,7 @@ private:
 		result.bandwidth = 1;
 		result.minScore = 0;
 		result.scores.addEmptyNodeMap(1);
-		auto nodes = params.graph.nodeLookup.at(bigraphNodeId);
-		assert(offset < params.graph.originalNodeSize.at(bigraphNodeId));
+		assert(offset < params.graph.OriginalNodeSize(bigraphNodeId));
 		size_t nodeIndex = params.graph.GetUnitigNode(bigraphNodeId, offset);
 		assert(params.graph.nodeOffset[nodeIndex] <= offset);
 		assert(params.graph.nodeOffset[nodeIndex] + params.graph.NodeLength(nodeIndex) > offset);
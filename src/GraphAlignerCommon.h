@@ -7,6 +7,57 @@
 #include "ComponentPriorityQueue.h"
 #include "NodeSlice.h"
 #include "WordSlice.h"
+#include "PagedArray.h"
+
+//per-node flags of the nodes in a band
+//the set flags are remembered so they can be reset in time proportional to the band instead of the graph
+class BandFlags
+{
+public:
+	BandFlags(size_t size) :
+	flags(size),
+	setIndices(),
+	numSet(0)
+	{
+	}
+	bool operator[](size_t index) const
+	{
+		return flags[index];
+	}
+	void set(size_t index)
+	{
+		if ((*this)[index]) return;
+		flags.set(index, true);
+		setIndices.push_back(index);
+		numSet++;
+	}
+	void unset(size_t index)
+	{
+		if (!(*this)[index]) return;
+		flags.set(index, false);
+		assert(numSet > 0);
+		numSet--;
+		//the unset indices stay in the list until the band is empty, so the list can't grow past the nodes set since then
+		if (numSet == 0) setIndices.clear();
+	}
+	size_t size() const
+	{
+		return flags.size();
+	}
+	void clear()
+	{
+		for (auto index : setIndices)
+		{
+			flags.set(index, false);
+		}
+		setIndices.clear();
+		numSet = 0;
+	}
+private:
+	PagedArray<bool> flags;
+	std::vector<size_t> setIndices;
+	size_t numSet;
+};
 
 template <typename LengthType, typename ScoreType, typename Word>
 class GraphAlignerCommon
@@ -54,54 +105,61 @@ public:
 		calculableQueue(WordConfiguration<Word>::WordSize * 2 + 3 * maxBandwidth + 1, graph.NodeSize()),
 		evenNodesliceMap(),
 		oddNodesliceMap(),
-		currentBand(),
-		previousBand()
+		currentBand(graph.NodeSize()),
+		previousBand(graph.NodeSize())
 		{
 			if (!lowMemory)
 			{
-				evenNodesliceMap.resize(graph.NodeSize(), {});
-				oddNodesliceMap.resize(graph.NodeSize(), {});
+				evenNodesliceMap.items.resize(graph.NodeSize());
+				oddNodesliceMap.items.resize(graph.NodeSize());
 			}
-			currentBand.resize(graph.NodeSize(), false);
-			previousBand.resize(graph.NodeSize(), false);
 		}
+		//only resets what the previous alignment touched, so the cost is proportional to the band and not the graph
 		void clear()
 		{
-			evenNodesliceMap.assign(evenNodesliceMap.size(), {});
-			oddNodesliceMap.assign(oddNodesliceMap.size(), {});
+			evenNodesliceMap.clear();
+			oddNodesliceMap.clear();
 			componentQueue.clear();
 			calculableQueue.clear();
-			currentBand.assign(currentBand.size(), false);
-			previousBand.assign(previousBand.size(), false);
+			currentBand.clear();
+			previousBand.clear();
 		}
 		ComponentPriorityQueue<EdgeWithPriority> componentQueue;
 		ArrayPriorityQueue<EdgeWithPriority> calculableQueue;
-		std::vector<typename NodeSlice<LengthType, ScoreType, Word, true>::MapItem> evenNodesliceMap;
-		std::vector<typename NodeSlice<LengthType, ScoreType, Word, true>::MapItem> oddNodesliceMap;
-		std::vector<bool> currentBand;
-		std::vector<bool> previousBand;
+		typename NodeSlice<LengthType, ScoreType, Word, true>::VectorMapType evenNodesliceMap;
+		typename NodeSlice<LengthType, ScoreType, Word, true>::VectorMapType oddNodesliceMap;
+		BandFlags currentBand;
+		BandFlags previousBand;
 	};
 	using MatrixPosition = AlignmentGraph::MatrixPosition;
 	class Params
 	{
 	public:
-		Params(LengthType initialBandwidth, LengthType rampBandwidth, const AlignmentGraph& graph, size_t maxCellsPerSlice, bool quietMode, bool sloppyOptimizations, bool lowMemory) :
+		Params(size_t initialBandwidth, size_t rampBandwidth, const AlignmentGraph& graph, size_t maxCellsPerSlice, bool quietMode, bool sloppyOptimizations, bool lowMemory, bool checkpointSlices, bool scoreOnlyFirstPass, bool joinExtendedSeeds) :
 		initialBandwidth(initialBandwidth),
 		rampBandwidth(rampBandwidth),
 		graph(graph),
 		maxCellsPerSlice(maxCellsPerSlice),
 		quietMode(quietMode),
 		sloppyOptimizations(sloppyOptimizations),
-		lowMemory(lowMemory)
+		lowMemory(lowMemory),
+		checkpointSlices(checkpointSlices),
+		scoreOnlyFirstPass(scoreOnlyFirstPass),
+		joinExtendedSeeds(joinExtendedSeeds)
 		{
 		}
-		const LengthType initialBandwidth;
-		const LengthType rampBandwidth;
+		const size_t initialBandwidth;
+		const size_t rampBandwidth;
 		const AlignmentGraph& graph;
 		const size_t maxCellsPerSlice;
 		const bool quietMode;
 		const bool sloppyOptimizations;
 		const bool lowMemory;
+		const bool checkpointSlices;
+		//extend all seeds without the backtrace first, and backtrace only the alignments which are selected
+		const bool scoreOnlyFirstPass;
+		//in the score-only first pass, don't extend seeds on the path of an earlier extension of the read. may change the output
+		const bool joinExtendedSeeds;
 	};
 	class OnewayTrace
 	{
@@ -5,16 +5,41 @@
 #include "GraphAligner.h"
 #include "ThreadReadAssertion.h"
 
-AlignmentResult AlignOneWay(const AlignmentGraph& graph, const std::string& seq_id, const std::string& sequence, size_t initialBandwidth, size_t rampBandwidth, bool quietMode, GraphAlignerCommon<size_t, int32_t, uint64_t>::AlignerGraphsizedState& reusableState, bool lowMemory)
+namespace
 {
-	GraphAlignerCommon<size_t, int32_t, uint64_t>::Params params {initialBandwidth, rampBandwidth, graph, std::numeric_limits<size_t>::max(), quietMode, false, lowMemory};
-	GraphAligner<size_t, int32_t, uint64_t> aligner {params};
-	return aligner.AlignOneWay(seq_id, sequence, reusableState);
+	template <typename LengthType, typename Word>
+	AlignmentResult AlignOneWayWithWord(const AlignmentGraph& graph, const std::string& seq_id, const std::string& sequence, size_t initialBandwidth, size_t rampBandwidth, bool quietMode, typename GraphAlignerCommon<LengthType, int32_t, Word>::AlignerGraphsizedState& reusableState, bool lowMemory, bool checkpointSlices, bool scoreOnlyFirstPass)
+	{
+		typename GraphAlignerCommon<LengthType, int32_t, Word>::Params params {initialBandwidth, rampBandwidth, graph, std::numeric_limits<size_t>::max(), quietMode, false, lowMemory, checkpointSlices, scoreOnlyFirstPass, false};
+		GraphAligner<LengthType, int32_t, Word> aligner {params};
+		return aligner.AlignOneWay(seq_id, sequence, reusableState);
+	}
+
+	template <typename LengthType, typename Word>
+	AlignmentResult AlignOneWayWithWord(const AlignmentGraph& graph, const std::string& seq_id, const std::string& sequence, size_t initialBandwidth, size_t rampBandwidth, size_t maxCellsPerSlice, bool quietMode, bool sloppyOptimizations, const std::vector<SeedHit>& seedHits, typename GraphAlignerCommon<LengthType, int32_t, Word>::AlignerGraphsizedState& reusableState, bool lowMemory, bool checkpointSlices, bool scoreOnlyFirstPass, bool joinExtendedSeeds)
+	{
+		typename GraphAlignerCommon<LengthType, int32_t, Word>::Params params {initialBandwidth, rampBandwidth, graph, maxCellsPerSlice, quietMode, sloppyOptimizations, lowMemory, checkpointSlices, scoreOnlyFirstPass, joinExtendedSeeds};
+		GraphAligner<LengthType, int32_t, Word> aligner {params};
+		return aligner.AlignOneWay(seq_id, sequence, seedHits, reusableState);
+	}
+}
+
+AlignmentResult AlignOneWay(const AlignmentGraph& graph, const std::string& seq_id, const std::string& sequence, size_t initialBandwidth, size_t rampBandwidth, bool quietMode, GraphAlignerCommon<uint32_t, int32_t, uint64_t>::AlignerGraphsizedState& reusableState, bool lowMemory, bool checkpointSlices, bool scoreOnlyFirstPass)
+{
+	return AlignOneWayWithWord<uint32_t, uint64_t>(graph, seq_id, sequence, initialBandwidth, rampBandwidth, quietMode, reusableState, lowMemory, checkpointSlices, scoreOnlyFirstPass);
+}
+
+AlignmentResult AlignOneWay(const AlignmentGraph& graph, const std::string& seq_id, const std::string& sequence, size_t initialBandwidth, size_t rampBandwidth, size_t maxCellsPerSlice, bool quietMode, bool sloppyOptimizations, const std::vector<SeedHit>& seedHits, GraphAlignerCommon<uint32_t, int32_t, uint64_t>::AlignerGraphsizedState& reusableState, bool lowMemory, bool checkpointSlices, bool scoreOnlyFirstPass, bool joinExtendedSeeds)
+{
+	return AlignOneWayWithWord<uint32_t, uint64_t>(graph, seq_id, sequence, initialBandwidth, rampBandwidth, maxCellsPerSlice, quietMode, sloppyOptimizations, seedHits, reusableState, lowMemory, checkpointSlices, scoreOnlyFirstPass, joinExtendedSeeds);
+}
+
+AlignmentResult AlignOneWay(const AlignmentGraph& graph, const std::string& seq_id, const std::string& sequence, size_t initialBandwidth, size_t rampBandwidth, bool quietMode, GraphAlignerCommon<uint32_t, int32_t, __uint128_t>::AlignerGraphsizedState& reusableState, bool lowMemory, bool checkpointSlices, bool scoreOnlyFirstPass)
+{
+	return AlignOneWayWithWord<uint32_t, __uint128_t>(graph, seq_id, sequence, initialBandwidth, rampBandwidth, quietMode, reusableState, lowMemory, checkpointSlices, scoreOnlyFirstPass);
 }
 
-AlignmentResult AlignOneWay(const AlignmentGraph& graph, const std::string& seq_id, const std::string& sequence, size_t initialBandwidth, size_t rampBandwidth, size_t maxCellsPerSlice, bool quietMode, bool sloppyOptimizations, const std::vector<SeedHit>& seedHits, GraphAlignerCommon<size_t, int32_t, uint64_t>::AlignerGraphsizedState& reusableState, bool lowMemory)
+AlignmentResult AlignOneWay(const AlignmentGraph& graph, const std::string& seq_id, const std::string& sequence, size_t initialBandwidth, size_t rampBandwidth, size_t maxCellsPerSlice, bool quietMode, bool sloppyOptimizations, const std::vector<SeedHit>& seedHits, GraphAlignerCommon<uint32_t, int32_t, __uint128_t>::AlignerGraphsizedState& reusableState, bool lowMemory, bool checkpointSlices, bool scoreOnlyFirstPass, bool joinExtendedSeeds)
 {
-	GraphAlignerCommon<size_t, int32_t, uint64_t>::Params params {initialBandwidth, rampBandwidth, graph, maxCellsPerSlice, quietMode, sloppyOptimizations, lowMemory};
-	GraphAligner<size_t, int32_t, uint64_t> aligner {params};
-	return aligner.AlignOneWay(seq_id, sequence, seedHits, reusableState);
+	return AlignOneWayWithWord<uint32_t, __uint128_t>(graph, seq_id, sequence, initialBandwidth, rampBandwidth, maxCellsPerSlice, quietMode, sloppyOptimizations, seedHits, reusableState, lowMemory, checkpointSlices, scoreOnlyFirstPass, joinExtendedSeeds);
 }
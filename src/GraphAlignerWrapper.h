@@ -83,7 +83,13 @@ public:
 	bool reverse;
 };
 
-AlignmentResult AlignOneWay(const AlignmentGraph& graph, const std::string& seq_id, const std::string& sequence, size_t initialBandwidth, size_t rampBandwidth, bool quietMode, GraphAlignerCommon<size_t, int32_t, uint64_t>::AlignerGraphsizedState& reusableState, bool lowMemory);
-AlignmentResult AlignOneWay(const AlignmentGraph& graph, const std::string& seq_id, const std::string& sequence, size_t initialBandwidth, size_t rampBandwidth, size_t maxCellsPerSlice, bool quietMode, bool sloppyOptimizations, const std::vector<SeedHit>& seedHits, GraphAlignerCommon<size_t, int32_t, uint64_t>::AlignerGraphsizedState& reusableState, bool lowMemory);
+//the word type of the reusable state picks the instantiation. wider words have more rows per slice
+//node indices and sequence positions in the DP are uint32_t. the graph loader rejects graphs with more nodes than that
 
-#endif
\ No newline at end of file
+AlignmentResult AlignOneWay(const AlignmentGraph& graph, const std::string& seq_id, const std::string& sequence, size_t initialBandwidth, size_t rampBandwidth, bool quietMode, GraphAlignerCommon<uint32_t, int32_t, uint64_t>::AlignerGraphsizedState& reusableState, bool lowMemory, bool checkpointSlices, bool scoreOnlyFirstPass);
+AlignmentResult AlignOneWay(const AlignmentGraph& graph, const std::string& seq_id, const std::string& sequence, size_t initialBandwidth, size_t rampBandwidth, size_t maxCellsPerSlice, bool quietMode, bool sloppyOptimizations, const std::vector<SeedHit>& seedHits, GraphAlignerCommon<uint32_t, int32_t, uint64_t>::AlignerGraphsizedState& reusableState, bool lowMemory, bool checkpointSlices, bool scoreOnlyFirstPass, bool joinExtendedSeeds);
+
+AlignmentResult AlignOneWay(const AlignmentGraph& graph, const std::string& seq_id, const std::string& sequence, size_t initialBandwidth, size_t rampBandwidth, bool quietMode, GraphAlignerCommon<uint32_t, int32_t, __uint128_t>::AlignerGraphsizedState& reusableState, bool lowMemory, bool checkpointSlices, bool scoreOnlyFirstPass);
+AlignmentResult AlignOneWay(const AlignmentGraph& graph, const std::string& seq_id, const std::string& sequence, size_t initialBandwidth, size_t rampBandwidth, size_t maxCellsPerSlice, bool quietMode, bool sloppyOptimizations, const std::vector<SeedHit>& seedHits, GraphAlignerCommon<uint32_t, int32_t, __uint128_t>::AlignerGraphsizedState& reusableState, bool lowMemory, bool checkpointSlices, bool scoreOnlyFirstPass, bool joinExtendedSeeds);
+
+#endif
\ No newline at end of file
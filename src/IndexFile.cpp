@@ -0,0 +1,195 @@
+#include <cstdio>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "IndexFile.h"
+
+//identifies the file as an index, the type and version of the index follow
+const std::string IndexMagic = "GraphAligner-index";
+//the fingerprint hashes this many bytes from both ends of the graph file
+const size_t FingerprintSampleBytes = 1024 * 1024;
+
+namespace
+{
+	uint64_t hashBytes(uint64_t hash, const char* bytes, size_t size)
+	{
+		//fnv-1a
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= (unsigned char)bytes[i];
+			hash *= 0x100000001b3ULL;
+		}
+		return hash;
+	}
+	size_t paddingTo8(size_t size)
+	{
+		return (8 - size % 8) % 8;
+	}
+}
+
+GraphFingerprint GraphFingerprint::FromFile(const std::string& filename)
+{
+	GraphFingerprint result { { 0, 0, 0, 0 } };
+	struct stat fileStat;
+	if (stat(filename.c_str(), &fileStat) != 0) return result;
+	result.values[0] = fileStat.st_size;
+	result.values[1] = (uint64_t)fileStat.st_mtim.tv_sec * 1000000000ULL + fileStat.st_mtim.tv_nsec;
+	std::ifstream file { filename, std::ios::binary };
+	std::vector<char> buffer;
+	buffer.resize(std::min((size_t)fileStat.st_size, FingerprintSampleBytes));
+	file.read(buffer.data(), buffer.size());
+	result.values[2] = hashBytes(0xcbf29ce484222325ULL, buffer.data(), file.gcount());
+	file.clear();
+	file.seekg(fileStat.st_size - buffer.size());
+	file.read(buffer.data(), buffer.size());
+	result.values[3] = hashBytes(0xcbf29ce484222325ULL, buffer.data(), file.gcount());
+	return result;
+}
+
+bool GraphFingerprint::operator==(const GraphFingerprint& other) const
+{
+	return values[0] == other.values[0] && values[1] == other.values[1] && values[2] == other.values[2] && values[3] == other.values[3];
+}
+
+bool GraphFingerprint::operator!=(const GraphFingerprint& other) const
+{
+	return !(*this == other);
+}
+
+MemoryMappedFile::MemoryMappedFile(const std::string& filename) :
+mapping(nullptr),
+mappingSize(0),
+mapped(false)
+{
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd == -1) return;
+	struct stat fileStat;
+	if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		close(fd);
+		return;
+	}
+	void* result = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	//the mapping stays valid after the descriptor is closed
+	close(fd);
+	if (result == MAP_FAILED) return;
+	mapping = (const char*)result;
+	mappingSize = fileStat.st_size;
+	mapped = true;
+}
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+	if (mapped) munmap((void*)mapping, mappingSize);
+}
+
+bool MemoryMappedFile::valid() const
+{
+	return mapped;
+}
+
+const char* MemoryMappedFile::data() const
+{
+	return mapping;
+}
+
+size_t MemoryMappedFile::size() const
+{
+	return mappingSize;
+}
+
+IndexFileWriter::IndexFileWriter(const std::string& filename, const std::string& indexType, uint64_t version, const GraphFingerprint& graph) :
+filename(filename),
+tempFilename(filename + ".tmp" + std::to_string(getpid())),
+file(tempFilename, std::ios::binary),
+written(0)
+{
+	writeArray(IndexMagic);
+	writeArray(indexType);
+	writeValue(version);
+	writeArray(graph.values, 4);
+}
+
+void IndexFileWriter::writeValue(uint64_t value)
+{
+	writeBytes((const char*)&value, sizeof(value));
+}
+
+void IndexFileWriter::writeArray(const std::string& values)
+{
+	writeArray(values.data(), values.size());
+}
+
+void IndexFileWriter::writeBytes(const char* bytes, size_t size)
+{
+	const char zeros[8] { 0, 0, 0, 0, 0, 0, 0, 0 };
+	file.write(bytes, size);
+	file.write(zeros, paddingTo8(size));
+	written += size + paddingTo8(size);
+}
+
+bool IndexFileWriter::finish()
+{
+	file.close();
+	if (!file.good() || rename(tempFilename.c_str(), filename.c_str()) != 0)
+	{
+		remove(tempFilename.c_str());
+		return false;
+	}
+	return true;
+}
+
+IndexFileReader::IndexFileReader(const std::string& filename, const std::string& indexType, uint64_t version, const GraphFingerprint& graph) :
+file(std::make_shared<MemoryMappedFile>(filename)),
+pos(0),
+headerValid(true)
+{
+	std::string magic, type;
+	uint64_t fileVersion = 0;
+	const uint64_t* fingerprint = nullptr;
+	size_t fingerprintSize = 0;
+	if (!file->valid() || !readArray(magic) || magic != IndexMagic || !readArray(type) || type != indexType || !readValue(fileVersion) || fileVersion != version || !readArray(fingerprint, fingerprintSize) || fingerprintSize != 4)
+	{
+		headerValid = false;
+		return;
+	}
+	GraphFingerprint fileGraph;
+	memcpy(fileGraph.values, fingerprint, sizeof(fileGraph.values));
+	headerValid = fileGraph == graph;
+}
+
+bool IndexFileReader::valid() const
+{
+	return headerValid;
+}
+
+bool IndexFileReader::readValue(uint64_t& value)
+{
+	if (!file->valid() || pos + sizeof(value) > file->size()) return false;
+	memcpy(&value, file->data() + pos, sizeof(value));
+	pos += sizeof(value);
+	return true;
+}
+
+bool IndexFileReader::readArray(std::string& values)
+{
+	const char* data;
+	size_t count;
+	if (!readArray(data, count)) return false;
+	values.assign(data, count);
+	return true;
+}
+
+bool IndexFileReader::readArrayBytes(size_t elementSize, const char*& bytes, size_t& count)
+{
+	uint64_t fileElementSize, fileCount;
+	if (!readValue(fileElementSize) || !readValue(fileCount)) return false;
+	if (fileElementSize != elementSize) return false;
+	if (fileCount > (file->size() - pos) / elementSize) return false;
+	size_t size = fileCount * elementSize;
+	bytes = file->data() + pos;
+	count = fileCount;
+	pos += size + paddingTo8(size);
+	return true;
+}
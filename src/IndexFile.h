@@ -0,0 +1,160 @@
+#ifndef IndexFile_h
+#define IndexFile_h
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+//identifies the graph file an index was built from: its size, modification time and a hash of its start and end
+//hashing the whole file would take as long as loading it, so edits which keep the size, the mtime and both ends are not noticed
+struct GraphFingerprint
+{
+	static GraphFingerprint FromFile(const std::string& filename);
+	bool operator==(const GraphFingerprint& other) const;
+	bool operator!=(const GraphFingerprint& other) const;
+	uint64_t values[4];
+};
+
+//read-only shared mapping of a whole file. pages are shared through the page cache between processes mapping the same file
+class MemoryMappedFile
+{
+public:
+	MemoryMappedFile(const std::string& filename);
+	~MemoryMappedFile();
+	MemoryMappedFile(const MemoryMappedFile& other) = delete;
+	MemoryMappedFile& operator=(const MemoryMappedFile& other) = delete;
+	//false if the file could not be opened or mapped
+	bool valid() const;
+	const char* data() const;
+	size_t size() const;
+private:
+	const char* mapping;
+	size_t mappingSize;
+	bool mapped;
+};
+
+//an array which is either owned or points into a memory mapped index file which it keeps alive
+template <typename T>
+class MappedArray
+{
+public:
+	MappedArray() :
+	owned(),
+	file(),
+	ptr(nullptr),
+	count(0)
+	{
+	}
+	MappedArray(const MappedArray& other) = delete;
+	MappedArray& operator=(const MappedArray& other) = delete;
+	//moving the owned vector keeps its buffer, so ptr stays valid
+	MappedArray(MappedArray&& other) = default;
+	MappedArray& operator=(MappedArray&& other) = default;
+	void assign(std::vector<T>&& values)
+	{
+		owned = std::move(values);
+		file.reset();
+		ptr = owned.data();
+		count = owned.size();
+	}
+	void map(std::shared_ptr<const MemoryMappedFile> mappedFile, const T* data, size_t size)
+	{
+		std::vector<T>().swap(owned);
+		file = mappedFile;
+		ptr = data;
+		count = size;
+	}
+	const T* begin() const { return ptr; }
+	const T* end() const { return ptr + count; }
+	const T* data() const { return ptr; }
+	size_t size() const { return count; }
+	const T& operator[](size_t index) const { return ptr[index]; }
+	const T& back() const { return ptr[count-1]; }
+private:
+	std::vector<T> owned;
+	std::shared_ptr<const MemoryMappedFile> file;
+	const T* ptr;
+	size_t count;
+};
+
+//binary index format: a header with the index type, its version and the graph fingerprint,
+//followed by 64-bit values and arrays. every array starts at an 8-byte aligned offset so it can be used in place from a mapping
+//the file is written next to its final name and renamed when complete, so concurrent aligners never see a partial index
+class IndexFileWriter
+{
+public:
+	IndexFileWriter(const std::string& filename, const std::string& indexType, uint64_t version, const GraphFingerprint& graph);
+	void writeValue(uint64_t value);
+	template <typename T>
+	void writeArray(const T* values, size_t count)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "index arrays must be trivially copyable");
+		writeValue(sizeof(T));
+		writeValue(count);
+		writeBytes((const char*)values, count * sizeof(T));
+	}
+	template <typename T>
+	void writeArray(const std::vector<T>& values)
+	{
+		writeArray(values.data(), values.size());
+	}
+	void writeArray(const std::string& values);
+	//renames the file to its final name. returns false if writing failed
+	bool finish();
+private:
+	void writeBytes(const char* bytes, size_t size);
+	std::string filename;
+	std::string tempFilename;
+	std::ofstream file;
+	size_t written;
+};
+
+//reads an index written by IndexFileWriter from a read-only mapping
+//every read returns false if the index is not valid or is truncated
+class IndexFileReader
+{
+public:
+	IndexFileReader(const std::string& filename, const std::string& indexType, uint64_t version, const GraphFingerprint& graph);
+	//false if the file doesn't exist, is of a different type or version, or was built from a different graph
+	bool valid() const;
+	bool readValue(uint64_t& value);
+	template <typename T>
+	bool readArray(const T*& values, size_t& count)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "index arrays must be trivially copyable");
+		const char* bytes;
+		if (!readArrayBytes(sizeof(T), bytes, count)) return false;
+		values = (const T*)bytes;
+		return true;
+	}
+	template <typename T>
+	bool readArray(std::vector<T>& values)
+	{
+		const T* data;
+		size_t count;
+		if (!readArray(data, count)) return false;
+		values.assign(data, data + count);
+		return true;
+	}
+	template <typename T>
+	bool readArray(MappedArray<T>& values)
+	{
+		const T* data;
+		size_t count;
+		if (!readArray(data, count)) return false;
+		values.map(file, data, count);
+		return true;
+	}
+	bool readArray(std::string& values);
+private:
+	bool readArrayBytes(size_t elementSize, const char*& bytes, size_t& count);
+	std::shared_ptr<const MemoryMappedFile> file;
+	size_t pos;
+	bool headerValid;
+};
+
+#endif
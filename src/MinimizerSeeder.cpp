@@ -0,0 +1,294 @@
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <omp.h>
+#include "MinimizerSeeder.h"
+
+//the cache format, bump when the index contents change
+const std::string CacheType = "minimizers";
+const uint64_t CacheVersion = 2;
+//at most this many paths are indexed from each node for the windows which cross node boundaries
+const size_t MaxPathsPerNode = 16;
+//minimizers which occur more often than this in the graph are repeats and aren't used as seeds
+const size_t MaxMinimizerOccurrences = 100;
+//average number of index entries per bucket in the bucket directory
+const size_t EntriesPerBucket = 4;
+
+namespace
+{
+	//invertible hash so the minimizer order is not lexicographic
+	uint64_t hashKmer(uint64_t kmer)
+	{
+		kmer = (kmer ^ (kmer >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		kmer = (kmer ^ (kmer >> 27)) * 0x94d049bb133111ebULL;
+		return kmer ^ (kmer >> 31);
+	}
+	int baseValue(char c)
+	{
+		switch(c)
+		{
+			case 'a':
+			case 'A':
+				return 0;
+			case 'c':
+			case 'C':
+				return 1;
+			case 'g':
+			case 'G':
+				return 2;
+			case 't':
+			case 'T':
+			case 'u':
+			case 'U':
+				return 3;
+			default:
+				return -1;
+		}
+	}
+}
+
+MinimizerSeeder::MinimizerSeeder(const AlignmentGraph& graph, const std::string& graphFile, size_t k, size_t w, const std::string& cacheFile) :
+k(k),
+w(w),
+bucketBits(1),
+hashes(),
+positions(),
+bucketStart()
+{
+	assert(k >= 1);
+	assert(k <= 31);
+	assert(w >= 1);
+	GraphFingerprint fingerprint = GraphFingerprint::FromFile(graphFile);
+	if (cacheFile.size() == 0 || !loadFrom(cacheFile, fingerprint))
+	{
+		build(graph);
+		if (cacheFile.size() > 0) saveTo(cacheFile, fingerprint);
+	}
+}
+
+size_t MinimizerSeeder::size() const
+{
+	return hashes.size();
+}
+
+template <typename F>
+void MinimizerSeeder::iterateMinimizers(const std::string& text, size_t windowStarts, F callback) const
+{
+	if (text.size() < k) return;
+	size_t numKmers = text.size() - k + 1;
+	std::vector<uint64_t> kmerHashes;
+	std::vector<bool> valid;
+	kmerHashes.resize(numKmers);
+	valid.resize(numKmers, false);
+	uint64_t kmer = 0;
+	uint64_t mask = ((uint64_t)1 << (2 * k)) - 1;
+	size_t validBases = 0;
+	for (size_t i = 0; i < text.size(); i++)
+	{
+		int value = baseValue(text[i]);
+		if (value == -1)
+		{
+			validBases = 0;
+			kmer = 0;
+			continue;
+		}
+		kmer = ((kmer << 2) | value) & mask;
+		validBases += 1;
+		if (validBases >= k)
+		{
+			kmerHashes[i - k + 1] = hashKmer(kmer);
+			valid[i - k + 1] = true;
+		}
+	}
+	//a sequence shorter than one window is one shorter window
+	size_t windowSize = std::min(w, numKmers);
+	size_t numWindows = std::min(windowStarts, numKmers - windowSize + 1);
+	std::vector<size_t> window;
+	size_t windowFront = 0;
+	size_t lastPos = std::numeric_limits<size_t>::max();
+	for (size_t i = 0; i < numWindows + windowSize - 1; i++)
+	{
+		if (valid[i])
+		{
+			while (window.size() > windowFront && kmerHashes[window.back()] > kmerHashes[i]) window.pop_back();
+			window.push_back(i);
+		}
+		if (i + 1 < windowSize) continue;
+		size_t windowStart = i + 1 - windowSize;
+		while (window.size() > windowFront && window[windowFront] < windowStart) windowFront++;
+		if (window.size() == windowFront) continue;
+		size_t pos = window[windowFront];
+		if (pos == lastPos) continue;
+		lastPos = pos;
+		callback(kmerHashes[pos], pos);
+	}
+}
+
+//collects the sequences of the paths of length bases starting from node, and the graph position of each base
+void MinimizerSeeder::addPaths(const AlignmentGraph& graph, size_t node, size_t length, std::string& text, std::vector<uint64_t>& textPositions, std::vector<std::pair<std::string, std::vector<uint64_t>>>& result) const
+{
+	if (result.size() >= MaxPathsPerNode) return;
+	size_t oldSize = text.size();
+	size_t take = std::min(length, graph.NodeLength(node));
+	for (size_t i = 0; i < take; i++)
+	{
+		text.push_back(graph.NodeSequences(node, i));
+		textPositions.push_back(((uint64_t)graph.nodeIDs[node] << 32) + graph.nodeOffset[node] + i);
+	}
+	if (take == length || graph.outNeighbors[node].size() == 0)
+	{
+		result.emplace_back(text, textPositions);
+	}
+	else
+	{
+		for (auto neighbor : graph.outNeighbors[node])
+		{
+			addPaths(graph, neighbor, length - take, text, textPositions, result);
+		}
+	}
+	text.resize(oldSize);
+	textPositions.resize(oldSize);
+}
+
+//the windows starting in the node, continuing along the paths from the node
+void MinimizerSeeder::addNodeMinimizers(const AlignmentGraph& graph, size_t node, std::vector<Minimizer>& result) const
+{
+	size_t nodeLength = graph.NodeLength(node);
+	std::vector<std::pair<std::string, std::vector<uint64_t>>> paths;
+	std::string text;
+	std::vector<uint64_t> textPositions;
+	addPaths(graph, node, nodeLength + k + w - 2, text, textPositions, paths);
+	for (const auto& path : paths)
+	{
+		iterateMinimizers(path.first, nodeLength, [&result, &path](uint64_t hash, size_t pos)
+		{
+			result.push_back(Minimizer { hash, path.second[pos] });
+		});
+	}
+}
+
+void MinimizerSeeder::build(const AlignmentGraph& graph)
+{
+	std::vector<std::vector<Minimizer>> threadMinimizers;
+	threadMinimizers.resize(omp_get_max_threads());
+	#pragma omp parallel for schedule(dynamic, 1024)
+	for (size_t node = 0; node < graph.NodeSize(); node++)
+	{
+		addNodeMinimizers(graph, node, threadMinimizers[omp_get_thread_num()]);
+	}
+	size_t total = 0;
+	for (const auto& minimizers : threadMinimizers)
+	{
+		total += minimizers.size();
+	}
+	bucketBits = 1;
+	while (bucketBits < 32 && ((size_t)1 << (bucketBits + 1)) * EntriesPerBucket <= total) bucketBits++;
+	size_t numBuckets = (size_t)1 << bucketBits;
+	//bucket sort by the top bits of the hash, then sort each bucket in parallel
+	std::vector<uint64_t> bucketEnd;
+	bucketEnd.resize(numBuckets + 1, 0);
+	for (const auto& minimizers : threadMinimizers)
+	{
+		for (auto minimizer : minimizers)
+		{
+			bucketEnd[(minimizer.hash >> (64 - bucketBits)) + 1] += 1;
+		}
+	}
+	for (size_t i = 1; i <= numBuckets; i++)
+	{
+		bucketEnd[i] += bucketEnd[i-1];
+	}
+	std::vector<uint64_t> scatterPos { bucketEnd.begin(), bucketEnd.end() - 1 };
+	std::vector<Minimizer> sorted;
+	sorted.resize(total);
+	for (auto& minimizers : threadMinimizers)
+	{
+		for (auto minimizer : minimizers)
+		{
+			sorted[scatterPos[minimizer.hash >> (64 - bucketBits)]++] = minimizer;
+		}
+		std::vector<Minimizer>().swap(minimizers);
+	}
+	//the same minimizer can be found from multiple nodes' paths
+	std::vector<uint64_t> uniqueInBucket;
+	uniqueInBucket.resize(numBuckets, 0);
+	#pragma omp parallel for schedule(dynamic, 64)
+	for (size_t bucket = 0; bucket < numBuckets; bucket++)
+	{
+		auto start = sorted.begin() + bucketEnd[bucket];
+		auto end = sorted.begin() + bucketEnd[bucket+1];
+		std::sort(start, end, [](const Minimizer& left, const Minimizer& right) { return left.hash < right.hash || (left.hash == right.hash && left.position < right.position); });
+		uniqueInBucket[bucket] = std::unique(start, end, [](const Minimizer& left, const Minimizer& right) { return left.hash == right.hash && left.position == right.position; }) - start;
+	}
+	std::vector<uint64_t> newBucketStart;
+	newBucketStart.resize(numBuckets + 1, 0);
+	for (size_t i = 0; i < numBuckets; i++)
+	{
+		newBucketStart[i+1] = newBucketStart[i] + uniqueInBucket[i];
+	}
+	std::vector<uint64_t> newHashes;
+	std::vector<uint64_t> newPositions;
+	newHashes.resize(newBucketStart.back());
+	newPositions.resize(newBucketStart.back());
+	#pragma omp parallel for schedule(dynamic, 64)
+	for (size_t bucket = 0; bucket < numBuckets; bucket++)
+	{
+		for (size_t i = 0; i < uniqueInBucket[bucket]; i++)
+		{
+			newHashes[newBucketStart[bucket] + i] = sorted[bucketEnd[bucket] + i].hash;
+			newPositions[newBucketStart[bucket] + i] = sorted[bucketEnd[bucket] + i].position;
+		}
+	}
+	hashes.assign(std::move(newHashes));
+	positions.assign(std::move(newPositions));
+	bucketStart.assign(std::move(newBucketStart));
+}
+
+std::vector<SeedHit> MinimizerSeeder::getSeeds(const std::string& sequence) const
+{
+	std::vector<SeedHit> result;
+	iterateMinimizers(sequence, sequence.size(), [this, &result](uint64_t hash, size_t seqPos)
+	{
+		size_t bucket = hash >> (64 - bucketBits);
+		auto start = hashes.begin() + bucketStart[bucket];
+		auto end = hashes.begin() + bucketStart[bucket+1];
+		auto found = std::equal_range(start, end, hash);
+		if (found.second - found.first > (ptrdiff_t)MaxMinimizerOccurrences) return;
+		for (auto iter = found.first; iter != found.second; ++iter)
+		{
+			uint64_t position = positions[iter - hashes.begin()];
+			int directedNodeId = position >> 32;
+			size_t nodeOffset = position & 0xFFFFFFFF;
+			result.emplace_back(directedNodeId / 2, nodeOffset, seqPos, k, directedNodeId % 2 == 1);
+		}
+	});
+	return result;
+}
+
+void MinimizerSeeder::saveTo(const std::string& cacheFile, const GraphFingerprint& graph) const
+{
+	IndexFileWriter file { cacheFile, CacheType, CacheVersion, graph };
+	file.writeValue(k);
+	file.writeValue(w);
+	file.writeValue(bucketBits);
+	file.writeArray(hashes.data(), hashes.size());
+	file.writeArray(positions.data(), positions.size());
+	file.writeArray(bucketStart.data(), bucketStart.size());
+	if (!file.finish()) std::cerr << "Could not write the minimizer cache to " << cacheFile << std::endl;
+}
+
+//returns false if there is no cache, or it is from an older version, was built from a different graph or with different parameters, and has to be rebuilt
+//the index is used in place from the read-only mapping, so concurrent aligners share one copy through the page cache
+bool MinimizerSeeder::loadFrom(const std::string& cacheFile, const GraphFingerprint& graph)
+{
+	IndexFileReader file { cacheFile, CacheType, CacheVersion, graph };
+	if (!file.valid()) return false;
+	uint64_t cachedK, cachedW, cachedBucketBits;
+	if (!file.readValue(cachedK) || !file.readValue(cachedW) || !file.readValue(cachedBucketBits)) return false;
+	if (cachedK != k || cachedW != w || cachedBucketBits < 1 || cachedBucketBits > 32) return false;
+	if (!file.readArray(hashes)) return false;
+	if (!file.readArray(positions)) return false;
+	if (!file.readArray(bucketStart)) return false;
+	bucketBits = cachedBucketBits;
+	return bucketStart.size() == ((size_t)1 << bucketBits) + 1 && hashes.size() == positions.size() && bucketStart.back() == hashes.size();
+}
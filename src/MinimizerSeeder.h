@@ -0,0 +1,45 @@
+#ifndef MinimizerSeeder_h
+#define MinimizerSeeder_h
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "AlignmentGraph.h"
+#include "GraphAlignerWrapper.h"
+#include "IndexFile.h"
+
+//finds seeds by looking up the (w,k)-minimizers of the read in a hash index of the graph's minimizers
+//both orientations of the graph are indexed, so only the forward strand of the read is queried
+//minimizers of windows which cross node boundaries are indexed along the paths from each node
+class MinimizerSeeder
+{
+public:
+	MinimizerSeeder(const AlignmentGraph& graph, const std::string& graphFile, size_t k, size_t w, const std::string& cacheFile);
+	std::vector<SeedHit> getSeeds(const std::string& sequence) const;
+	size_t size() const;
+private:
+	struct Minimizer
+	{
+		uint64_t hash;
+		uint64_t position;
+	};
+	void build(const AlignmentGraph& graph);
+	void addNodeMinimizers(const AlignmentGraph& graph, size_t node, std::vector<Minimizer>& result) const;
+	void addPaths(const AlignmentGraph& graph, size_t node, size_t length, std::string& text, std::vector<uint64_t>& positions, std::vector<std::pair<std::string, std::vector<uint64_t>>>& result) const;
+	//calls the callback with the hash and start position of the minimizer of each window starting before windowStarts, skipping repeats of the same position
+	template <typename F>
+	void iterateMinimizers(const std::string& text, size_t windowStarts, F callback) const;
+	void saveTo(const std::string& cacheFile, const GraphFingerprint& graph) const;
+	bool loadFrom(const std::string& cacheFile, const GraphFingerprint& graph);
+	size_t k;
+	size_t w;
+	size_t bucketBits;
+	//minimizer hashes in sorted order, and the graph positions (directed node id << 32 | offset) of each
+	//when loaded from the cache these point into the mapped cache file
+	MappedArray<uint64_t> hashes;
+	MappedArray<uint64_t> positions;
+	//hashes with top bucketBits bits i are in the range [bucketStart[i], bucketStart[i+1])
+	MappedArray<uint64_t> bucketStart;
+};
+
+#endif
@@ -1,8 +1,11 @@
 #include <iostream>
-#include <boost/archive/text_oarchive.hpp>
-#include <boost/archive/text_iarchive.hpp>
-#include <boost/serialization/vector.hpp>
+#include <set>
+#include <cstdio>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "CommonUtils.h"
+#include "IndexFile.h"
 #include "MummerSeeder.h"
 
 char lowercase(char c)
@@ -31,74 +34,227 @@ char lowercase(char c)
 	return std::numeric_limits<char>::max();
 }
 
-bool fileExists(const std::string& fileName)
+//removes a directory written by sparseSA::save, which contains only files
+void removeDirectory(const std::string& path)
 {
-	std::ifstream file { fileName };
-	return file.good();
+	DIR* dir = opendir(path.c_str());
+	if (dir == nullptr) return;
+	while (dirent* entry = readdir(dir))
+	{
+		std::string name = entry->d_name;
+		if (name == "." || name == "..") continue;
+		remove((path + "/" + name).c_str());
+	}
+	closedir(dir);
+	rmdir(path.c_str());
 }
 
-MummerSeeder::MummerSeeder(const GfaGraph& graph, const std::string& cachePrefix)
+char complement(char c)
 {
-	if (cachePrefix.size() > 0 && fileExists(cachePrefix + ".aux"))
+	switch(c)
 	{
-		loadFrom(cachePrefix);
+		case 'a':
+			return 't';
+		case 'c':
+			return 'g';
+		case 'g':
+			return 'c';
+		case 't':
+			return 'a';
+		default:
+			return '`';
 	}
-	else
+}
+
+//the cache format, bump when the index contents change
+const std::string CacheType = "mummer";
+const uint64_t CacheVersion = 3;
+//an edge gets at most this many junctions, one per distinct path from the target node
+const size_t MaxJunctionPathsPerEdge = 16;
+
+MummerSeeder::MummerSeeder(const AlignmentGraph& graph, const std::string& graphFile, const std::string& cachePrefix, size_t minMatchLength) :
+junctionLength(minMatchLength > 0 ? minMatchLength - 1 : 0)
+{
+	GraphFingerprint fingerprint = GraphFingerprint::FromFile(graphFile);
+	if (cachePrefix.size() == 0 || !loadFrom(cachePrefix, fingerprint))
 	{
 		initTree(graph);
-		if (cachePrefix.size() > 0) saveTo(cachePrefix);
+		if (cachePrefix.size() > 0) saveTo(cachePrefix, fingerprint);
 	}
 }
 
-MummerSeeder::MummerSeeder(const vg::Graph& graph, const std::string& cachePrefix)
+//the original nodes are the forward (even) directed nodes of the alignment graph, concatenated from their split nodes
+//the edges out of the last split node of a directed node are the original edges, and the overlap is where the edge enters the target
+void MummerSeeder::initTree(const AlignmentGraph& graph)
 {
-	if (cachePrefix.size() > 0 && fileExists(cachePrefix + ".aux"))
+	size_t totalLength = 0;
+	for (size_t i = 0; i < graph.originalNodeIDs.size(); i++)
 	{
-		loadFrom(cachePrefix);
+		if (graph.originalNodeIDs[i] % 2 == 0) totalLength += graph.originalNodeSizes[i] + 1;
 	}
-	else
+	seq.reserve(totalLength);
+	std::vector<std::tuple<NodePos, NodePos, size_t>> edges;
+	for (size_t i = 0; i < graph.originalNodeIDs.size(); i++)
 	{
-		initTree(graph);
-		if (cachePrefix.size() > 0) saveTo(cachePrefix);
+		int directedId = graph.originalNodeIDs[i];
+		if (directedId % 2 == 0)
+		{
+			nodePositions.push_back(seq.size());
+			nodeIDs.push_back(directedId / 2);
+			for (size_t j = graph.originalNodeSplitStart[i]; j < graph.originalNodeSplitStart[i+1]; j++)
+			{
+				size_t node = graph.originalNodeSplitNodes[j];
+				for (size_t k = 0; k < graph.NodeLength(node); k++)
+				{
+					seq += lowercase(graph.NodeSequences(node, k));
+				}
+			}
+			seq += '`';
+		}
+		assert(graph.originalNodeSplitStart[i+1] > graph.originalNodeSplitStart[i]);
+		size_t last = graph.originalNodeSplitNodes[graph.originalNodeSplitStart[i+1]-1];
+		for (auto target : graph.outNeighbors[last])
+		{
+			int targetId = graph.nodeIDs[target];
+			edges.emplace_back(NodePos { directedId / 2, directedId % 2 == 0 }, NodePos { targetId / 2, targetId % 2 == 0 }, graph.nodeOffset[target]);
+		}
 	}
+	addJunctions(edges);
+	buildMatcher();
 }
 
-void MummerSeeder::initTree(const GfaGraph& graph)
+void MummerSeeder::buildMatcher()
 {
-	for (auto node : graph.nodes)
+	//every node and junction is followed by a separator, including the last one, so nodeLength works for all of them
+	nodePositions.push_back(seq.size());
+	seq.shrink_to_fit();
+	matcher = std::make_unique<mummer::mummer::sparseSA>(mummer::mummer::sparseSA::create_auto(seq.c_str(), seq.size(), 0, true));
+}
+
+std::string MummerSeeder::orientedSubstring(size_t nodeIndex, bool reverse, size_t start, size_t length) const
+{
+	size_t nodeStart = nodePositions[nodeIndex];
+	if (!reverse) return seq.substr(nodeStart + start, length);
+	size_t nodeLen = nodeLength(nodeIndex);
+	std::string result = seq.substr(nodeStart + nodeLen - start - length, length);
+	std::reverse(result.begin(), result.end());
+	for (size_t i = 0; i < result.size(); i++)
 	{
-		nodePositions.push_back(seq.size());
-		nodeIDs.push_back(node.first);
-		seq += node.second;
-		seq += '`';
+		result[i] = complement(result[i]);
 	}
-	seq.pop_back();
-	nodePositions.push_back(seq.size());
-	for (size_t i = 0; i < seq.size(); i++)
+	return result;
+}
+
+//appends the possible continuations of length bases starting from the skip'th base of pos to head
+void MummerSeeder::addJunctionHeads(const std::unordered_map<NodePos, std::vector<std::pair<NodePos, size_t>>>& outEdges, const std::unordered_map<int, size_t>& nodeIndex, NodePos pos, size_t skip, size_t length, std::string& head, std::vector<std::string>& result) const
+{
+	if (result.size() >= MaxJunctionPathsPerEdge) return;
+	size_t index = nodeIndex.at(pos.id);
+	size_t nodeLen = nodeLength(index);
+	if (skip >= nodeLen) return;
+	size_t take = std::min(length, nodeLen - skip);
+	size_t oldSize = head.size();
+	head += orientedSubstring(index, !pos.end, skip, take);
+	auto found = outEdges.find(pos);
+	if (take == length || found == outEdges.end())
 	{
-		seq[i] = lowercase(seq[i]);
+		result.push_back(head);
 	}
-	seq.shrink_to_fit();
-	matcher = std::make_unique<mummer::mummer::sparseSA>(mummer::mummer::sparseSA::create_auto(seq.c_str(), seq.size(), 0, true));
+	else
+	{
+		for (auto edge : found->second)
+		{
+			addJunctionHeads(outEdges, nodeIndex, edge.first, edge.second, length - take, head, result);
+		}
+	}
+	head.resize(oldSize);
 }
 
-void MummerSeeder::initTree(const vg::Graph& graph)
+//a match of at least junctionLength+1 bases in a junction must start in the source node's part and cross the edge
+void MummerSeeder::addJunctions(const std::vector<std::tuple<NodePos, NodePos, size_t>>& edges)
 {
-	for (int i = 0; i < graph.node_size(); i++)
+	if (junctionLength == 0) return;
+	std::unordered_map<int, size_t> nodeIndex;
+	for (size_t i = 0; i < nodeIDs.size(); i++)
 	{
-		nodePositions.push_back(seq.size());
-		nodeIDs.push_back(graph.node(i).id());
-		seq += graph.node(i).sequence();
-		seq += '`';
+		nodeIndex[nodeIDs[i]] = i;
 	}
-	seq.pop_back();
-	nodePositions.push_back(seq.size());
-	for (size_t i = 0; i < seq.size(); i++)
+	//the graph might list only one direction of an edge, or both. the reverse direction of an edge is needed for the paths
+	//but matches to its junctions would only duplicate the reverse complement of the forward direction's junctions
+	std::set<std::tuple<int, bool, int, bool>> canonicalEdges;
+	std::unordered_map<NodePos, std::vector<std::pair<NodePos, size_t>>> outEdges;
+	std::set<std::tuple<int, bool, int, bool>> seenEdges;
+	std::vector<std::tuple<NodePos, NodePos, size_t>> junctionEdges;
+	for (auto edge : edges)
 	{
-		seq[i] = lowercase(seq[i]);
+		NodePos from = std::get<0>(edge);
+		NodePos to = std::get<1>(edge);
+		size_t overlap = std::get<2>(edge);
+		if (nodeIndex.count(from.id) == 0 || nodeIndex.count(to.id) == 0) continue;
+		auto forwardKey = std::make_tuple(from.id, from.end, to.id, to.end);
+		auto backwardKey = std::make_tuple(to.id, !to.end, from.id, !from.end);
+		if (seenEdges.count(forwardKey) == 0)
+		{
+			seenEdges.insert(forwardKey);
+			outEdges[from].emplace_back(to, overlap);
+		}
+		if (seenEdges.count(backwardKey) == 0)
+		{
+			seenEdges.insert(backwardKey);
+			outEdges[to.Reverse()].emplace_back(from.Reverse(), overlap);
+		}
+		auto canonicalKey = std::min(forwardKey, backwardKey);
+		if (canonicalEdges.count(canonicalKey) == 1) continue;
+		canonicalEdges.insert(canonicalKey);
+		junctionEdges.push_back(edge);
+	}
+	std::vector<std::string> heads;
+	std::string head;
+	for (auto edge : junctionEdges)
+	{
+		NodePos from = std::get<0>(edge);
+		NodePos to = std::get<1>(edge);
+		size_t overlap = std::get<2>(edge);
+		size_t fromIndex = nodeIndex.at(from.id);
+		size_t fromLength = nodeLength(fromIndex);
+		//with long overlaps every match of junctionLength+1 bases is already inside a node
+		if (overlap >= junctionLength || overlap >= fromLength) continue;
+		//the tail ends where the overlap starts, the overlapping bases are at the start of the head
+		size_t tailStart = fromLength - std::min(fromLength, junctionLength);
+		size_t tailLength = fromLength - overlap - tailStart;
+		std::string tail = orientedSubstring(fromIndex, !from.end, tailStart, tailLength);
+		heads.clear();
+		head.clear();
+		addJunctionHeads(outEdges, nodeIndex, to, 0, junctionLength, head, heads);
+		for (auto& junctionHead : heads)
+		{
+			nodePositions.push_back(seq.size());
+			junctionNode.push_back(fromIndex);
+			junctionReverse.push_back(!from.end);
+			junctionTailStart.push_back(tailStart);
+			junctionTailLength.push_back(tailLength);
+			seq += tail;
+			seq += junctionHead;
+			seq += '`';
+		}
 	}
-	seq.shrink_to_fit();
-	matcher = std::make_unique<mummer::mummer::sparseSA>(mummer::mummer::sparseSA::create_auto(seq.c_str(), seq.size(), 0, true));
+}
+
+//the suffix array files are named after everything the aux file is validated with, so a run with another graph or match length
+//writes its own suffix array instead of replacing the one another aligner is loading, and an aux file can't be paired with a stale suffix array
+std::string MummerSeeder::suffixArrayDirectory(const std::string& prefix, const GraphFingerprint& graph) const
+{
+	uint64_t key[6] { graph.values[0], graph.values[1], graph.values[2], graph.values[3], CacheVersion, junctionLength };
+	//fnv-1a
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (size_t i = 0; i < sizeof(key); i++)
+	{
+		hash ^= ((const unsigned char*)key)[i];
+		hash *= 0x100000001b3ULL;
+	}
+	char hex[17];
+	snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hash);
+	return prefix + "_index_" + hex;
 }
 
 size_t MummerSeeder::getNodeIndex(size_t indexPos) const
@@ -110,30 +266,82 @@ size_t MummerSeeder::getNodeIndex(size_t indexPos) const
 	return index;
 }
 
-void MummerSeeder::saveTo(const std::string& prefix) const
+//the suffix array is saved by mummer into a temporary directory which is renamed when complete, and the aux file is written last
+//so its presence means the cache is complete
+void MummerSeeder::saveTo(const std::string& prefix, const GraphFingerprint& graph) const
 {
-	std::ofstream file { prefix + ".aux", std::ios::binary };
+	std::string indexDirectory = suffixArrayDirectory(prefix, graph);
+	std::string tempDirectory = indexDirectory + ".tmp" + std::to_string(getpid());
+	removeDirectory(tempDirectory);
+	bool saved = mkdir(tempDirectory.c_str(), 0777) == 0 && matcher->save(tempDirectory + "/sa");
+	//another aligner with the same graph and match length may have renamed an identical suffix array into place first
+	struct stat existing;
+	if (saved && rename(tempDirectory.c_str(), indexDirectory.c_str()) != 0 && stat(indexDirectory.c_str(), &existing) != 0) saved = false;
+	removeDirectory(tempDirectory);
+	if (!saved)
 	{
-		boost::archive::text_oarchive oa(file);
-		oa << seq;
-		oa << nodePositions;
-		oa << nodeIDs;
+		std::cerr << "Could not write the seeder cache to " << indexDirectory << std::endl;
+		return;
 	}
-	matcher->save(prefix + "_index");
+	IndexFileWriter file { prefix + ".aux", CacheType, CacheVersion, graph };
+	file.writeValue(junctionLength);
+	file.writeArray(seq);
+	file.writeArray(nodePositions);
+	file.writeArray(nodeIDs);
+	file.writeArray(junctionNode);
+	file.writeArray(junctionReverse);
+	file.writeArray(junctionTailStart);
+	file.writeArray(junctionTailLength);
+	if (!file.finish()) std::cerr << "Could not write the seeder cache to " << prefix << ".aux" << std::endl;
 }
 
-void MummerSeeder::loadFrom(const std::string& prefix)
+//returns false if there is no cache, or it is from an older version, was built from a different graph or with a different match length, and has to be rebuilt
+//the suffix array is read into memory by mummer, only the aux file is read from a mapping
+bool MummerSeeder::loadFrom(const std::string& prefix, const GraphFingerprint& graph)
 {
-	std::ifstream file { prefix + ".aux", std::ios::binary };
-	{
-		boost::archive::text_iarchive ia(file);
-		ia >> seq;
-		ia >> nodePositions;
-		ia >> nodeIDs;
-	}
+	IndexFileReader file { prefix + ".aux", CacheType, CacheVersion, graph };
+	if (!file.valid()) return false;
+	uint64_t cachedJunctionLength;
+	if (!file.readValue(cachedJunctionLength) || cachedJunctionLength != junctionLength) return false;
+	//read everything before replacing the members so a truncated cache leaves the seeder empty for rebuilding
+	std::string cachedSeq;
+	std::vector<size_t> cachedNodePositions;
+	std::vector<int> cachedNodeIDs;
+	std::vector<size_t> cachedJunctionNode;
+	std::vector<uint8_t> cachedJunctionReverse;
+	std::vector<size_t> cachedJunctionTailStart;
+	std::vector<size_t> cachedJunctionTailLength;
+	if (!file.readArray(cachedSeq)) return false;
+	if (!file.readArray(cachedNodePositions)) return false;
+	if (!file.readArray(cachedNodeIDs)) return false;
+	if (!file.readArray(cachedJunctionNode)) return false;
+	if (!file.readArray(cachedJunctionReverse)) return false;
+	if (!file.readArray(cachedJunctionTailStart)) return false;
+	if (!file.readArray(cachedJunctionTailLength)) return false;
+	seq = std::move(cachedSeq);
+	nodePositions = std::move(cachedNodePositions);
+	nodeIDs = std::move(cachedNodeIDs);
+	junctionNode = std::move(cachedJunctionNode);
+	junctionReverse = std::move(cachedJunctionReverse);
+	junctionTailStart = std::move(cachedJunctionTailStart);
+	junctionTailLength = std::move(cachedJunctionTailLength);
+	//sparseSA needs the sequence as a string, so this is the one copy out of the mapping
 	// same params that create_auto with minlen=0 passes
 	matcher = std::make_unique<mummer::mummer::sparseSA>(seq, false, 1, true, false, false, 1, 0, true);
-	matcher->load(prefix + "_index");
+	if (!matcher->load(suffixArrayDirectory(prefix, graph) + "/sa"))
+	{
+		//leave the seeder empty for rebuilding
+		matcher.reset();
+		std::string().swap(seq);
+		std::vector<size_t>().swap(nodePositions);
+		std::vector<int>().swap(nodeIDs);
+		std::vector<size_t>().swap(junctionNode);
+		std::vector<uint8_t>().swap(junctionReverse);
+		std::vector<size_t>().swap(junctionTailStart);
+		std::vector<size_t>().swap(junctionTailLength);
+		return false;
+	}
+	return true;
 }
 
 std::vector<SeedHit> MummerSeeder::getMumSeeds(std::string sequence, size_t maxCount, size_t minLen) const
@@ -143,12 +351,16 @@ std::vector<SeedHit> MummerSeeder::getMumSeeds(std::string sequence, size_t maxC
 		sequence[i] = lowercase(sequence[i]);
 	}
 	assert(matcher != nullptr);
-	std::vector<mummer::mummer::match_t> MAMs;
-	matcher->MAM(sequence, minLen, false, MAMs);
+	//the junctions of an edge repeat the source node's tail for every head, and heads can share a prefix,
+	//so a match can occur several times in the index at one graph position. mummer's MAMs would count those as repeats
+	std::vector<SeedHit> seeds;
+	std::vector<mummer::mummer::match_t> MEMs;
+	matcher->MEM(sequence, minLen, false, MEMs);
+	addUniqueSeeds(sequence.size(), std::move(MEMs), false, seeds);
 	revcompInPlace(sequence);
-	std::vector<mummer::mummer::match_t> bwMAMs;
-	matcher->MAM(sequence, minLen, false, bwMAMs);
-	auto seeds = matchesToSeeds(sequence.size(), MAMs, bwMAMs);
+	std::vector<mummer::mummer::match_t> bwMEMs;
+	matcher->MEM(sequence, minLen, false, bwMEMs);
+	addUniqueSeeds(sequence.size(), std::move(bwMEMs), true, seeds);
 	std::sort(seeds.begin(), seeds.end(), [](const SeedHit& left, const SeedHit& right) { return left.matchLen > right.matchLen; });
 	if (seeds.size() > maxCount)
 	{
@@ -178,38 +390,91 @@ std::vector<SeedHit> MummerSeeder::getMemSeeds(std::string sequence, size_t maxC
 	return seeds;
 }
 
+//returns false for matches in junctions which don't start in the source node. they are already found in the node sequences
+bool MummerSeeder::matchToSeed(size_t seqLen, const mummer::mummer::match_t& match, bool backward, SeedHit& result) const
+{
+	auto index = getNodeIndex(match.ref);
+	size_t indexOffset = match.ref - nodePositions[index];
+	size_t seqPos = match.query;
+	size_t matchLen = match.len;
+	assert(match.len > 0);
+	assert(seqPos + matchLen <= seqLen);
+	if (index < nodeIDs.size())
+	{
+		int nodeID = nodeIDs[index];
+		size_t nodeOffset = indexOffset;
+		assert(nodeOffset + matchLen <= nodeLength(index));
+		if (backward)
+		{
+			nodeOffset = nodeLength(index) - nodeOffset - matchLen;
+			seqPos = seqLen - seqPos - matchLen;
+		}
+		assert(nodeOffset < nodeLength(index));
+		assert(seqPos < seqLen);
+		result = SeedHit { nodeID, nodeOffset, seqPos, matchLen, backward };
+		return true;
+	}
+	size_t junction = index - nodeIDs.size();
+	if (indexOffset >= junctionTailLength[junction]) return false;
+	//the seed is the first base of the match, which is in the source node
+	size_t sourceNode = junctionNode[junction];
+	size_t nodeOffset = junctionTailStart[junction] + indexOffset;
+	bool reverse = junctionReverse[junction];
+	if (backward)
+	{
+		nodeOffset = nodeLength(sourceNode) - nodeOffset - 1;
+		seqPos = seqLen - seqPos - 1;
+		reverse = !reverse;
+	}
+	assert(nodeOffset < nodeLength(sourceNode));
+	assert(seqPos < seqLen);
+	result = SeedHit { nodeIDs[sourceNode], nodeOffset, seqPos, matchLen, reverse };
+	return true;
+}
+
 std::vector<SeedHit> MummerSeeder::matchesToSeeds(size_t seqLen, const std::vector<mummer::mummer::match_t>& fwmatches, const std::vector<mummer::mummer::match_t>& bwmatches) const
 {
 	std::vector<SeedHit> result;
 	result.reserve(fwmatches.size() + bwmatches.size());
+	SeedHit seed { 0, 0, 0, 0, false };
 	for (auto match : fwmatches)
 	{
-		auto index = getNodeIndex(match.ref);
-		int nodeID = nodeIDs[index];
-		size_t nodeOffset = match.ref - nodePositions[index];
-		size_t seqPos = match.query;
-		size_t matchLen = match.len;
-		result.emplace_back(nodeID, nodeOffset, seqPos, matchLen, false);
+		if (matchToSeed(seqLen, match, false, seed)) result.push_back(seed);
 	}
 	for (auto match : bwmatches)
 	{
-		auto index = getNodeIndex(match.ref);
-		int nodeID = nodeIDs[index];
-		size_t nodeOffset = match.ref - nodePositions[index];
-		size_t seqPos = match.query;
-		size_t matchLen = match.len;
-		assert(match.len > 0);
-		assert(nodeOffset + matchLen <= nodeLength(index));
-		assert(seqPos + matchLen <= seqLen);
-		nodeOffset = nodeLength(index) - nodeOffset - matchLen;
-		seqPos = seqLen - seqPos - matchLen;
-		assert(nodeOffset < nodeLength(index));
-		assert(seqPos < seqLen);
-		result.emplace_back(nodeID, nodeOffset, seqPos, matchLen, true);
+		if (matchToSeed(seqLen, match, true, seed)) result.push_back(seed);
 	}
+	//a match inside a node's part of a junction is also found in the node itself
+	std::sort(result.begin(), result.end(), [](const SeedHit& left, const SeedHit& right) { return std::make_tuple(left.nodeID, left.reverse, left.nodeOffset, left.seqPos, left.matchLen) > std::make_tuple(right.nodeID, right.reverse, right.nodeOffset, right.seqPos, right.matchLen); });
+	result.erase(std::unique(result.begin(), result.end(), [](const SeedHit& left, const SeedHit& right) { return left.nodeID == right.nodeID && left.reverse == right.reverse && left.nodeOffset == right.nodeOffset && left.seqPos == right.seqPos; }), result.end());
 	return result;
 }
 
+//adds the maximal matches whose occurrences in the index are all at the same graph position
+void MummerSeeder::addUniqueSeeds(size_t seqLen, std::vector<mummer::mummer::match_t> matches, bool backward, std::vector<SeedHit>& result) const
+{
+	//the occurrences of a maximal match have the same read range
+	std::sort(matches.begin(), matches.end(), [](const mummer::mummer::match_t& left, const mummer::mummer::match_t& right) { return std::make_tuple(left.query, left.len, left.ref) < std::make_tuple(right.query, right.len, right.ref); });
+	SeedHit seed { 0, 0, 0, 0, false };
+	for (size_t i = 0; i < matches.size();)
+	{
+		size_t found = 0;
+		bool unique = true;
+		size_t j = i;
+		for (; j < matches.size() && matches[j].query == matches[i].query && matches[j].len == matches[i].len; j++)
+		{
+			//matches which don't start in a junction's source node are counted at their occurrence in the node sequence
+			if (!matchToSeed(seqLen, matches[j], backward, seed)) continue;
+			if (found > 0 && (seed.nodeID != result.back().nodeID || seed.reverse != result.back().reverse || seed.nodeOffset != result.back().nodeOffset)) unique = false;
+			if (found == 0) result.push_back(seed);
+			found += 1;
+		}
+		if (found > 0 && !unique) result.pop_back();
+		i = j;
+	}
+}
+
 size_t MummerSeeder::nodeLength(size_t indexPos) const
 {
 	//-1 for separator
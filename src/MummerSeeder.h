@@ -3,32 +3,50 @@
 
 #include <vector>
 #include <string>
+#include <tuple>
+#include <unordered_map>
 #include <mummer/sparseSA.hpp>
 #include <mummer/fasta.hpp>
 #include "GfaGraph.h"
+#include "IndexFile.h"
 #include "GraphAlignerWrapper.h"
-#include "vg.pb.h"
+#include "AlignmentGraph.h"
 
+//finds MUMs / MEMs between the read and the graph
+//the index contains the node sequences, and for every edge the last minMatchLength-1 bases of the source node followed by
+//the first minMatchLength-1 bases of the paths starting from the target node, so matches of at least minMatchLength can cross edges
 class MummerSeeder
 {
 public:
-	MummerSeeder(const GfaGraph& graph, const std::string& cachePrefix);
-	MummerSeeder(const vg::Graph& graph, const std::string& cachePrefix);
+	MummerSeeder(const AlignmentGraph& graph, const std::string& graphFile, const std::string& cachePrefix, size_t minMatchLength);
 	std::vector<SeedHit> getMemSeeds(std::string sequence, size_t maxCount, size_t minLen) const;
 	std::vector<SeedHit> getMumSeeds(std::string sequence, size_t maxCount, size_t minLen) const;
 private:
 	std::vector<SeedHit> matchesToSeeds(size_t seqLen, const std::vector<mummer::mummer::match_t>& fwmatches, const std::vector<mummer::mummer::match_t>& bwmatches) const;
+	void addUniqueSeeds(size_t seqLen, std::vector<mummer::mummer::match_t> matches, bool backward, std::vector<SeedHit>& result) const;
 	void revcompInPlace(std::string& seq) const;
+	bool matchToSeed(size_t seqLen, const mummer::mummer::match_t& match, bool backward, SeedHit& result) const;
 	size_t getNodeIndex(size_t indexPos) const;
 	size_t nodeLength(size_t indexPos) const;
-	void initTree(const GfaGraph& graph);
-	void initTree(const vg::Graph& graph);
-	void saveTo(const std::string& cachePrefix) const;
-	void loadFrom(const std::string& cachePrefix);
+	void initTree(const AlignmentGraph& graph);
+	void addJunctions(const std::vector<std::tuple<NodePos, NodePos, size_t>>& edges);
+	void addJunctionHeads(const std::unordered_map<NodePos, std::vector<std::pair<NodePos, size_t>>>& outEdges, const std::unordered_map<int, size_t>& nodeIndex, NodePos pos, size_t skip, size_t length, std::string& head, std::vector<std::string>& result) const;
+	std::string orientedSubstring(size_t nodeIndex, bool reverse, size_t start, size_t length) const;
+	void buildMatcher();
+	std::string suffixArrayDirectory(const std::string& prefix, const GraphFingerprint& graph) const;
+	void saveTo(const std::string& cachePrefix, const GraphFingerprint& graph) const;
+	bool loadFrom(const std::string& cachePrefix, const GraphFingerprint& graph);
 	std::string seq;
 	std::unique_ptr<mummer::mummer::sparseSA> matcher;
+	//start positions of the nodes and then the junctions in seq, followed by the end of seq
 	std::vector<size_t> nodePositions;
 	std::vector<int> nodeIDs;
+	size_t junctionLength;
+	//for each junction, the source node, its orientation, and where the junction's copy of the source node starts in the oriented node
+	std::vector<size_t> junctionNode;
+	std::vector<uint8_t> junctionReverse;
+	std::vector<size_t> junctionTailStart;
+	std::vector<size_t> junctionTailLength;
 };
 
 #endif
@@ -6,9 +6,10 @@
 #include <unordered_map>
 #include <vector>
 #include <type_traits>
-#include <sparsehash/dense_hash_map>
+#include <algorithm>
 #include "AlignmentGraph.h"
 #include "ThreadReadAssertion.h"
+#include "PagedArray.h"
 #include "WordSlice.h"
 
 
@@ -46,145 +47,257 @@ struct NodeSliceMapItemStruct
 #endif
 };
 
+//node index -> slice item map. the items are stored contiguously in insertion order with an open addressing index over them
+//the storages are recycled through a per-thread pool so the slices of consecutive rows and reads reuse the same allocations
+template <typename Key, typename Item>
+class FlatNodeMap
+{
+public:
+	static std::shared_ptr<FlatNodeMap> Create(size_t expectedSize)
+	{
+		auto& freeMaps = pool();
+		FlatNodeMap* result;
+		if (freeMaps.maps.size() > 0)
+		{
+			result = freeMaps.maps.back().release();
+			freeMaps.maps.pop_back();
+			freeMaps.bytes -= result->allocatedBytes();
+		}
+		else
+		{
+			result = new FlatNodeMap;
+		}
+		result->reserve(expectedSize);
+		return std::shared_ptr<FlatNodeMap>(result, &FlatNodeMap::Recycle);
+	}
+	size_t size() const
+	{
+		return keys.size();
+	}
+	//returns size() if the key is not in the map
+	size_t find(Key key) const
+	{
+		for (size_t slot = slotOf(key); ; slot = (slot + 1) & slotMask())
+		{
+			if (slots[slot] == 0) return keys.size();
+			if (keys[slots[slot]-1] == key) return slots[slot]-1;
+		}
+	}
+	//inserts a default item if the key is not in the map. references to items are invalidated by inserting
+	Item& operator[](Key key)
+	{
+		if ((keys.size() + 1) * 2 > slots.size()) rehash(slotBits + 1);
+		size_t slot = slotOf(key);
+		for (; slots[slot] != 0; slot = (slot + 1) & slotMask())
+		{
+			if (keys[slots[slot]-1] == key) return values[slots[slot]-1];
+		}
+		assert(keys.size() < std::numeric_limits<uint32_t>::max());
+		keys.push_back(key);
+		values.emplace_back();
+		slots[slot] = keys.size();
+		return values.back();
+	}
+	Key key(size_t pos) const
+	{
+		return keys[pos];
+	}
+	Item& value(size_t pos)
+	{
+		return values[pos];
+	}
+	const Item& value(size_t pos) const
+	{
+		return values[pos];
+	}
+private:
+	FlatNodeMap() :
+	keys(),
+	values(),
+	slots(),
+	slotBits(0)
+	{
+	}
+	struct Pool
+	{
+		std::vector<std::unique_ptr<FlatNodeMap>> maps;
+		//total allocated size of the maps in the pool
+		size_t bytes = 0;
+	};
+	static void Recycle(FlatNodeMap* map)
+	{
+		auto& freeMaps = pool();
+		size_t mapBytes = map->allocatedBytes();
+		if (freeMaps.bytes + mapBytes > MaxPooledBytes)
+		{
+			delete map;
+			return;
+		}
+		map->clear();
+		freeMaps.maps.emplace_back(map);
+		freeMaps.bytes += mapBytes;
+	}
+	static Pool& pool()
+	{
+		thread_local Pool freeMaps;
+		return freeMaps;
+	}
+	size_t allocatedBytes() const
+	{
+		return keys.capacity() * sizeof(Key) + values.capacity() * sizeof(Item) + slots.capacity() * sizeof(uint32_t);
+	}
+	size_t slotMask() const
+	{
+		return ((size_t)1 << slotBits) - 1;
+	}
+	size_t slotOf(size_t key) const
+	{
+		//fibonacci hashing, the top bits of the product are the best mixed
+		return (key * 0x9E3779B97F4A7C15ULL) >> (64 - slotBits);
+	}
+	void reserve(size_t size)
+	{
+		keys.reserve(size);
+		values.reserve(size);
+		size_t neededBits = MinSlotBits;
+		while (((size_t)1 << neededBits) < size * 2) neededBits++;
+		if (neededBits > slotBits) rehash(neededBits);
+	}
+	void rehash(size_t newSlotBits)
+	{
+		slotBits = std::max(newSlotBits, (size_t)MinSlotBits);
+		slots.assign((size_t)1 << slotBits, 0);
+		for (size_t i = 0; i < keys.size(); i++)
+		{
+			size_t slot = slotOf(keys[i]);
+			while (slots[slot] != 0) slot = (slot + 1) & slotMask();
+			slots[slot] = i+1;
+		}
+	}
+	void clear()
+	{
+		//only the slots of the stored keys are used, clearing them is cheaper than the whole table when the slice was small
+		for (auto key : keys)
+		{
+			size_t slot = slotOf(key);
+			while (slots[slot] != 0)
+			{
+				slots[slot] = 0;
+				slot = (slot + 1) & slotMask();
+			}
+		}
+		keys.clear();
+		values.clear();
+	}
+	static constexpr size_t MinSlotBits = 4;
+	//the maps kept in the pool take at most this many bytes per thread
+	static constexpr size_t MaxPooledBytes = 64 * 1024 * 1024;
+	std::vector<Key> keys;
+	std::vector<Item> values;
+	//position of the key in keys and values plus one, or zero for an empty slot
+	std::vector<uint32_t> slots;
+	size_t slotBits;
+};
+
+//graph-sized node slice storage which remembers the nodes in use, so it can be reset in time proportional to the band
+//the items are paged so that each thread's storage only takes memory for the nodes it has used
+template <typename Key, typename Item>
+struct NodeSliceVectorMap
+{
+	void clear()
+	{
+		for (auto index : activeIndices)
+		{
+			items.release(index);
+		}
+		activeIndices.clear();
+	}
+	PagedArray<Item> items;
+	std::vector<Key> activeIndices;
+};
+
 template <typename LengthType, typename ScoreType, typename Word, bool UseVectorMap>
 class NodeSlice
 {
 public:
 	using NodeSliceMapItem = NodeSliceMapItemStruct<LengthType, ScoreType, Word>;
-	using MapType = google::dense_hash_map<size_t, NodeSliceMapItem>;
+	using MapType = FlatNodeMap<LengthType, NodeSliceMapItem>;
 	using MapItem = NodeSliceMapItem;
-	class NodeSliceIterator : std::iterator<std::forward_iterator_tag, std::pair<size_t, MapItem>>
+	using VectorMapType = NodeSliceVectorMap<LengthType, NodeSliceMapItem>;
+	class NodeSliceIterator : std::iterator<std::forward_iterator_tag, std::pair<LengthType, MapItem>>
 	{
-		using map_iterator = typename MapType::iterator;
 	public:
-		template <bool HasVectorMap = UseVectorMap>
-		NodeSliceIterator(NodeSlice* slice, typename std::enable_if<!HasVectorMap, map_iterator>::type pos) :
-		slice(slice),
-		mappos(pos)
-		{
-		}
-		template <bool HasVectorMap = UseVectorMap>
-		NodeSliceIterator(NodeSlice* slice, typename std::enable_if<HasVectorMap, size_t>::type indexPos) :
+		NodeSliceIterator(NodeSlice* slice, size_t indexPos) :
 		slice(slice),
 		indexPos(indexPos)
 		{
 		}
 		template <bool HasVectorMap = UseVectorMap>
-		typename std::enable_if<HasVectorMap, std::pair<size_t, MapItem>>::type operator*()
+		typename std::enable_if<HasVectorMap, std::pair<LengthType, MapItem>>::type operator*() const
 		{
-			auto nodeindex = slice->activeVectorMapIndices[indexPos];
-			auto info = (*(slice->vectorMap))[nodeindex];
+			auto nodeindex = slice->vectorMap->activeIndices[indexPos];
+			auto info = slice->vectorMap->items.get(nodeindex);
 			return std::make_pair(nodeindex, info);
 		}
 		template <bool HasVectorMap = UseVectorMap>
-		typename std::enable_if<!HasVectorMap, std::pair<size_t, MapItem>>::type operator*()
+		typename std::enable_if<!HasVectorMap, std::pair<LengthType, MapItem>>::type operator*() const
 		{
-			return std::make_pair(mappos->first, mappos->second);
+			return std::make_pair(slice->nodes->key(indexPos), slice->nodes->value(indexPos));
 		}
-		template <bool HasVectorMap = UseVectorMap>
-		typename std::enable_if<HasVectorMap, std::pair<size_t, const MapItem>>::type operator*() const
-		{
-			auto nodeindex = slice->activeVectorMapIndices[indexPos];
-			auto info = (*(slice->vectorMap))[nodeindex];
-			return std::make_pair(nodeindex, info);
-		}
-		template <bool HasVectorMap = UseVectorMap>
-		typename std::enable_if<!HasVectorMap, std::pair<size_t, const MapItem>>::type operator*() const
-		{
-			return std::make_pair(mappos->first, mappos->second);
-		}
-		template <bool HasVectorMap = UseVectorMap>
-		typename std::enable_if<HasVectorMap, NodeSliceIterator&>::type operator++()
+		NodeSliceIterator& operator++()
 		{
 			indexPos++;
 			return *this;
 		}
-		template <bool HasVectorMap = UseVectorMap>
-		typename std::enable_if<!HasVectorMap, NodeSliceIterator&>::type operator++()
-		{
-			++mappos;
-			return *this;
-		}
-		template <bool HasVectorMap = UseVectorMap>
-		typename std::enable_if<HasVectorMap, bool>::type operator==(const NodeSliceIterator& other) const
+		bool operator==(const NodeSliceIterator& other) const
 		{
 			assert(slice == other.slice);
 			return indexPos == other.indexPos;
 		}
-		template <bool HasVectorMap = UseVectorMap>
-		typename std::enable_if<!HasVectorMap, bool>::type operator==(const NodeSliceIterator& other) const
-		{
-			assert(slice == other.slice);
-			return mappos == other.mappos;
-		}
 		bool operator!=(const NodeSliceIterator& other) const
 		{
 			return !(*this == other);
 		}
 	private:
 		NodeSlice* slice;
-		map_iterator mappos;
 		size_t indexPos;
 	};
-	class NodeSliceConstIterator : std::iterator<std::forward_iterator_tag, const std::pair<size_t, MapItem>>
+	class NodeSliceConstIterator : std::iterator<std::forward_iterator_tag, const std::pair<LengthType, MapItem>>
 	{
-		using map_iterator = typename MapType::const_iterator;
 	public:
-		template <bool HasVectorMap = UseVectorMap>
-		NodeSliceConstIterator(const NodeSlice* slice, typename std::enable_if<!HasVectorMap, map_iterator>::type pos) :
-		slice(slice),
-		mappos(pos)
-		{
-		}
-		template <bool HasVectorMap = UseVectorMap>
-		NodeSliceConstIterator(const NodeSlice* slice, typename std::enable_if<HasVectorMap, size_t>::type indexPos) :
+		NodeSliceConstIterator(const NodeSlice* slice, size_t indexPos) :
 		slice(slice),
 		indexPos(indexPos)
 		{
 		}
 		template <bool HasVectorMap = UseVectorMap>
-		typename std::enable_if<HasVectorMap, const std::pair<size_t, const MapItem>>::type operator*() const
+		typename std::enable_if<HasVectorMap, const std::pair<LengthType, const MapItem>>::type operator*() const
 		{
-			auto nodeindex = slice->activeVectorMapIndices[indexPos];
-			auto info = (*(slice->vectorMap))[nodeindex];
+			auto nodeindex = slice->vectorMap->activeIndices[indexPos];
+			auto info = slice->vectorMap->items.get(nodeindex);
 			return std::make_pair(nodeindex, info);
 		}
 		template <bool HasVectorMap = UseVectorMap>
-		typename std::enable_if<!HasVectorMap, const std::pair<size_t, const MapItem>>::type operator*() const
+		typename std::enable_if<!HasVectorMap, const std::pair<LengthType, const MapItem>>::type operator*() const
 		{
-			return std::make_pair(mappos->first, mappos->second);
+			return std::make_pair(slice->nodes->key(indexPos), slice->nodes->value(indexPos));
 		}
-		template <bool HasVectorMap = UseVectorMap>
-		typename std::enable_if<HasVectorMap, NodeSliceConstIterator&>::type operator++()
+		NodeSliceConstIterator& operator++()
 		{
 			indexPos++;
 			return *this;
 		}
-		template <bool HasVectorMap = UseVectorMap>
-		typename std::enable_if<!HasVectorMap, NodeSliceConstIterator&>::type operator++()
-		{
-			++mappos;
-			return *this;
-		}
-		template <bool HasVectorMap = UseVectorMap>
-		typename std::enable_if<HasVectorMap, bool>::type operator==(const NodeSliceConstIterator& other) const
+		bool operator==(const NodeSliceConstIterator& other) const
 		{
 			assert(slice == other.slice);
 			return indexPos == other.indexPos;
 		}
-		template <bool HasVectorMap = UseVectorMap>
-		typename std::enable_if<!HasVectorMap, bool>::type operator==(const NodeSliceConstIterator& other) const
-		{
-			assert(slice == other.slice);
-			return mappos == other.mappos;
-		}
 		bool operator!=(const NodeSliceConstIterator& other) const
 		{
 			return !(*this == other);
 		}
 	private:
 		const NodeSlice* slice;
-		map_iterator mappos;
 		size_t indexPos;
 	};
 	NodeSlice() :
@@ -193,7 +306,7 @@ public:
 	{
 	}
 	template <bool HasVectorMap = UseVectorMap>
-	NodeSlice(typename std::enable_if<HasVectorMap, std::vector<NodeSliceMapItem>*>::type vectorMap) :
+	NodeSlice(typename std::enable_if<HasVectorMap, VectorMapType*>::type vectorMap) :
 	vectorMap(vectorMap),
 	nodes(nullptr)
 	{
@@ -201,20 +314,18 @@ public:
 	void addEmptyNodeMap(size_t size)
 	{
 		assert(nodes == nullptr);
-		nodes = std::make_shared<MapType>();
-		nodes->set_empty_key(-1);
-		nodes->resize(size);
+		nodes = MapType::Create(size);
 	}
 	template <bool HasVectorMap = UseVectorMap>
 	typename std::enable_if<HasVectorMap, NodeSlice<LengthType, ScoreType, Word, false>>::type getMapSlice() const
 	{
 		assert(vectorMap != nullptr);
 		NodeSlice<LengthType, ScoreType, Word, false> result;
-		result.addEmptyNodeMap(activeVectorMapIndices.size());
-		for (auto index : activeVectorMapIndices)
+		result.addEmptyNodeMap(vectorMap->activeIndices.size());
+		for (auto index : vectorMap->activeIndices)
 		{
-			assert((*vectorMap)[index].exists);
-			(*result.nodes)[index] = (*vectorMap)[index];
+			assert(vectorMap->items.get(index).exists);
+			(*result.nodes)[index] = vectorMap->items.get(index);
 		}
 		return result;
 	}
@@ -227,26 +338,26 @@ public:
 		vectorMap = nullptr;
 	}
 	template <bool HasVectorMap = UseVectorMap>
-	typename std::enable_if<HasVectorMap>::type addNode(size_t nodeIndex)
+	typename std::enable_if<HasVectorMap>::type addNode(LengthType nodeIndex)
 	{
 		assert(vectorMap != nullptr);
-		assert(nodeIndex < vectorMap->size());
-		assert(!(*vectorMap)[nodeIndex].exists);
-		activeVectorMapIndices.push_back(nodeIndex);
-		(*vectorMap)[nodeIndex].minScore = std::numeric_limits<ScoreType>::max();
-		(*vectorMap)[nodeIndex].startSlice = { 0, 0, std::numeric_limits<ScoreType>::max() };
-		(*vectorMap)[nodeIndex].endSlice = { 0, 0, std::numeric_limits<ScoreType>::max() };
+		assert(nodeIndex < vectorMap->items.size());
+		assert(!vectorMap->items.get(nodeIndex).exists);
+		vectorMap->activeIndices.push_back(nodeIndex);
+		vectorMap->items[nodeIndex].minScore = std::numeric_limits<ScoreType>::max();
+		vectorMap->items[nodeIndex].startSlice = { 0, 0, std::numeric_limits<ScoreType>::max() };
+		vectorMap->items[nodeIndex].endSlice = { 0, 0, std::numeric_limits<ScoreType>::max() };
 #ifdef SLICEVERBOSE
-		(*vectorMap)[nodeIndex].slicesCalcedWhenCalced = std::numeric_limits<size_t>::max();
-		(*vectorMap)[nodeIndex].firstSlicesCalcedWhenCalced = std::numeric_limits<size_t>::max();
+		vectorMap->items[nodeIndex].slicesCalcedWhenCalced = std::numeric_limits<size_t>::max();
+		vectorMap->items[nodeIndex].firstSlicesCalcedWhenCalced = std::numeric_limits<size_t>::max();
 #endif
 	}
 	template <bool HasVectorMap = UseVectorMap>
-	typename std::enable_if<!HasVectorMap>::type addNode(size_t nodeIndex)
+	typename std::enable_if<!HasVectorMap>::type addNode(LengthType nodeIndex)
 	{
 		addNodeToMap(nodeIndex);
 	}
-	void addNodeToMap(size_t nodeIndex)
+	void addNodeToMap(LengthType nodeIndex)
 	{
 		assert(nodes != nullptr);
 		assert(vectorMap == nullptr);
@@ -256,91 +367,93 @@ public:
 		node.endSlice = { 0, 0, std::numeric_limits<ScoreType>::max() };
 	}
 	template <bool HasVectorMap = UseVectorMap>
-	typename std::enable_if<HasVectorMap, NodeSliceMapItem&>::type node(size_t nodeIndex)
+	typename std::enable_if<HasVectorMap, NodeSliceMapItem&>::type node(LengthType nodeIndex)
 	{
 		assert(vectorMap != nullptr);
-		assert(nodeIndex < vectorMap->size());
-		return (*vectorMap)[nodeIndex];
+		assert(nodeIndex < vectorMap->items.size());
+		return vectorMap->items[nodeIndex];
 	}
 	template <bool HasVectorMap = UseVectorMap>
-	typename std::enable_if<!HasVectorMap, NodeSliceMapItem&>::type node(size_t nodeIndex)
+	typename std::enable_if<!HasVectorMap, NodeSliceMapItem&>::type node(LengthType nodeIndex)
 	{
 		assert(nodes != nullptr);
 		auto found = nodes->find(nodeIndex);
-		assert(found != nodes->end());
-		return found->second;
+		assert(found != nodes->size());
+		return nodes->value(found);
 	}
 	template <bool HasVectorMap = UseVectorMap>
-	typename std::enable_if<HasVectorMap, const NodeSliceMapItem&>::type node(size_t nodeIndex) const
+	typename std::enable_if<HasVectorMap, const NodeSliceMapItem&>::type node(LengthType nodeIndex) const
 	{
 		assert(vectorMap != nullptr);
-		assert(nodeIndex < vectorMap->size());
-		return (*vectorMap)[nodeIndex];
+		const auto& items = vectorMap->items;
+		assert(nodeIndex < items.size());
+		return items[nodeIndex];
 	}
 	template <bool HasVectorMap = UseVectorMap>
-	typename std::enable_if<!HasVectorMap, const NodeSliceMapItem&>::type node(size_t nodeIndex) const
+	typename std::enable_if<!HasVectorMap, const NodeSliceMapItem&>::type node(LengthType nodeIndex) const
 	{
 		assert(nodes != nullptr);
 		auto found = nodes->find(nodeIndex);
-		assert(found != nodes->end());
-		return found->second;
+		assert(found != nodes->size());
+		return nodes->value(found);
 	}
 	template <bool HasVectorMap = UseVectorMap>
-	typename std::enable_if<HasVectorMap, bool>::type hasNode(size_t nodeIndex) const
+	typename std::enable_if<HasVectorMap, bool>::type hasNode(LengthType nodeIndex) const
 	{
 		assert(vectorMap != nullptr);
-		assert(nodeIndex < vectorMap->size());
-		return (*vectorMap)[nodeIndex].exists;
+		const auto& items = vectorMap->items;
+		assert(nodeIndex < items.size());
+		return items[nodeIndex].exists;
 	}
 	template <bool HasVectorMap = UseVectorMap>
-	typename std::enable_if<!HasVectorMap, bool>::type hasNode(size_t nodeIndex) const
+	typename std::enable_if<!HasVectorMap, bool>::type hasNode(LengthType nodeIndex) const
 	{
 		assert(nodes != nullptr);
 		auto found = nodes->find(nodeIndex);
-		if (found == nodes->end()) return false;
-		assert(found->second.exists);
+		if (found == nodes->size()) return false;
+		assert(nodes->value(found).exists);
 		return true;
 	}
 	template <bool HasVectorMap = UseVectorMap>
 	typename std::enable_if<HasVectorMap>::type removeNonExistant()
 	{
 		assert(vectorMap != nullptr);
-		std::vector<size_t> newActiveVectorMapIndices;
-		newActiveVectorMapIndices.reserve(activeVectorMapIndices.size());
-		for (auto index : activeVectorMapIndices)
+		std::vector<LengthType> newActiveIndices;
+		newActiveIndices.reserve(vectorMap->activeIndices.size());
+		for (auto index : vectorMap->activeIndices)
 		{
-			if ((*vectorMap)[index].exists) newActiveVectorMapIndices.push_back(index);
+			if (vectorMap->items.get(index).exists)
+			{
+				newActiveIndices.push_back(index);
+			}
+			else
+			{
+				vectorMap->items.release(index);
+			}
 		}
-		activeVectorMapIndices = newActiveVectorMapIndices;
+		vectorMap->activeIndices = newActiveIndices;
 	}
 	template <bool HasVectorMap = UseVectorMap>
 	typename std::enable_if<!HasVectorMap>::type removeNonExistant()
 	{
 		assert(nodes != nullptr);
-		std::vector<std::pair<size_t, MapItem>> newActiveMapItems;
-		newActiveMapItems.reserve(activeVectorMapIndices.size());
-		for (auto item : (*nodes))
+		auto newNodes = MapType::Create(nodes->size());
+		for (size_t i = 0; i < nodes->size(); i++)
 		{
-			if (item.second.exists) newActiveMapItems.push_back(item);
-		}
-		nodes = std::make_shared<MapType>();
-		nodes->set_empty_key(-1);
-		nodes->resize(newActiveMapItems.size());
-		for (auto item : newActiveMapItems)
-		{
-			(*nodes)[item.first] = item.second;
+			if (nodes->value(i).exists) (*newNodes)[nodes->key(i)] = nodes->value(i);
 		}
+		nodes = newNodes;
 	}
-	int minScore(size_t nodeIndex) const
+	int minScore(LengthType nodeIndex) const
 	{
 		return node(nodeIndex).minScore;
 	}
-	void setMinScoreIfSmaller(size_t nodeIndex, int score)
+	void setMinScoreIfSmaller(LengthType nodeIndex, int score)
 	{
 		auto oldScore = minScore(nodeIndex);
 		if (score < oldScore) setMinScore(nodeIndex, score);
 	}
-	void setMinScore(size_t nodeIndex, int score)
+	void setMinScore(LengthType nodeIndex, int score)
 	{
 		node(nodeIndex).minScore = score;
 	}
@@ -348,7 +461,7 @@ public:
 	typename std::enable_if<HasVectorMap, size_t>::type size() const
 	{
 		assert(vectorMap != nullptr);
-		return activeVectorMapIndices.size();
+		return vectorMap->activeIndices.size();
 	}
 	template <bool HasVectorMap = UseVectorMap>
 	typename std::enable_if<!HasVectorMap, size_t>::type size() const
@@ -366,19 +479,19 @@ public:
 	typename std::enable_if<!HasVectorMap, NodeSliceIterator>::type begin()
 	{
 		assert(nodes != nullptr);
-		return NodeSliceIterator { this, nodes->begin() };
+		return NodeSliceIterator { this, 0 };
 	}
 	template <bool HasVectorMap = UseVectorMap>
 	typename std::enable_if<HasVectorMap, NodeSliceIterator>::type end()
 	{
 		assert(vectorMap != nullptr);
-		return NodeSliceIterator { this, activeVectorMapIndices.size() };
+		return NodeSliceIterator { this, vectorMap->activeIndices.size() };
 	}
 	template <bool HasVectorMap = UseVectorMap>
 	typename std::enable_if<!HasVectorMap, NodeSliceIterator>::type end()
 	{
 		assert(nodes != nullptr);
-		return NodeSliceIterator { this, nodes->end() };
+		return NodeSliceIterator { this, nodes->size() };
 	}
 	template <bool HasVectorMap = UseVectorMap>
 	typename std::enable_if<HasVectorMap, NodeSliceConstIterator>::type begin() const
@@ -390,37 +503,40 @@ public:
 	typename std::enable_if<!HasVectorMap, NodeSliceConstIterator>::type begin() const
 	{
 		assert(nodes != nullptr);
-		return NodeSliceConstIterator { this, nodes->begin() };
+		return NodeSliceConstIterator { this, 0 };
 	}
 	template <bool HasVectorMap = UseVectorMap>
 	typename std::enable_if<HasVectorMap, NodeSliceConstIterator>::type end() const
 	{
 		assert(vectorMap != nullptr);
-		return NodeSliceConstIterator { this, activeVectorMapIndices.size() };
+		return NodeSliceConstIterator { this, vectorMap->activeIndices.size() };
 	}
 	template <bool HasVectorMap = UseVectorMap>
 	typename std::enable_if<!HasVectorMap, NodeSliceConstIterator>::type end() const
 	{
 		assert(nodes != nullptr);
-		return NodeSliceConstIterator { this, nodes->end() };
+		return NodeSliceConstIterator { this, nodes->size() };
 	}
 	bool hasVectorMapCurrently() const
 	{
 		return vectorMap != nullptr;
 	}
+	bool hasNodeMapCurrently() const
+	{
+		return nodes != nullptr;
+	}
+	void removeNodeMap()
+	{
+		nodes.reset();
+	}
 private:
 	template <bool HasVectorMap = UseVectorMap>
 	typename std::enable_if<HasVectorMap>::type clearVectorMap()
 	{
 		assert(vectorMap != nullptr);
-		for (auto index : activeVectorMapIndices)
-		{
-			(*vectorMap)[index].exists = false;
-		}
-		activeVectorMapIndices.clear();
+		vectorMap->clear();
 	}
-	std::vector<NodeSliceMapItem>* vectorMap;
-	std::vector<size_t> activeVectorMapIndices;
+	VectorMapType* vectorMap;
 	std::shared_ptr<MapType> nodes;
 	friend class NodeSliceIterator;
 	friend class NodeSliceConstIterator;
@@ -0,0 +1,167 @@
+#ifndef PagedArray_h
+#define PagedArray_h
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "ThreadReadAssertion.h"
+
+//fixed size array whose storage is allocated in pages of 2^PageBits items when an item is first written
+//reading an item on an unallocated page gives a default constructed item without allocating,
+//and a page is freed when all items written on it have been released, so graph-sized arrays only take memory
+//for the parts of the graph which are currently used
+template <typename T, size_t PageBits = 10>
+class PagedArray
+{
+	static constexpr size_t PageSize = (size_t)1 << PageBits;
+	static constexpr size_t PageMask = PageSize - 1;
+	struct Page
+	{
+		T items[PageSize];
+		uint64_t live[(PageSize + 63) / 64];
+		size_t numLive;
+	};
+public:
+	PagedArray() :
+	pages(),
+	numItems(0),
+	emptyItem()
+	{
+	}
+	PagedArray(size_t size) :
+	PagedArray()
+	{
+		resize(size);
+	}
+	PagedArray(PagedArray&& other) = default;
+	PagedArray& operator=(PagedArray&& other) = default;
+	void resize(size_t size)
+	{
+		numItems = size;
+		pages.resize((size + PageSize - 1) >> PageBits);
+	}
+	size_t size() const
+	{
+		return numItems;
+	}
+	//never allocates, use this for reads through a non-const array
+	const T& get(size_t index) const
+	{
+		assert(index < numItems);
+		const auto& page = pages[index >> PageBits];
+		if (page == nullptr) return emptyItem;
+		return page->items[index & PageMask];
+	}
+	const T& operator[](size_t index) const
+	{
+		return get(index);
+	}
+	//the item is in use until it is released
+	T& operator[](size_t index)
+	{
+		assert(index < numItems);
+		auto& page = pages[index >> PageBits];
+		if (page == nullptr) page.reset(new Page {});
+		size_t offset = index & PageMask;
+		uint64_t bit = (uint64_t)1 << (offset & 63);
+		if ((page->live[offset / 64] & bit) == 0)
+		{
+			page->live[offset / 64] |= bit;
+			page->numLive++;
+		}
+		return page->items[offset];
+	}
+	//resets the item to a default constructed one
+	void release(size_t index)
+	{
+		assert(index < numItems);
+		auto& page = pages[index >> PageBits];
+		if (page == nullptr) return;
+		size_t offset = index & PageMask;
+		uint64_t bit = (uint64_t)1 << (offset & 63);
+		if ((page->live[offset / 64] & bit) == 0) return;
+		page->items[offset] = T {};
+		page->live[offset / 64] &= ~bit;
+		assert(page->numLive > 0);
+		page->numLive--;
+		if (page->numLive == 0) page.reset();
+	}
+private:
+	std::vector<std::unique_ptr<Page>> pages;
+	size_t numItems;
+	T emptyItem;
+};
+
+//bit-packed flags. a page is allocated when its first flag is set and freed when its last set flag is unset,
+//so the memory follows the flags which are currently set
+template <size_t PageBits>
+class PagedArray<bool, PageBits>
+{
+	static constexpr size_t PageSize = (size_t)1 << PageBits;
+	static constexpr size_t PageMask = PageSize - 1;
+	struct Page
+	{
+		uint64_t bits[(PageSize + 63) / 64];
+		size_t numSet;
+	};
+public:
+	PagedArray() :
+	pages(),
+	numItems(0)
+	{
+	}
+	PagedArray(size_t size) :
+	PagedArray()
+	{
+		resize(size);
+	}
+	PagedArray(PagedArray&& other) = default;
+	PagedArray& operator=(PagedArray&& other) = default;
+	void resize(size_t size)
+	{
+		numItems = size;
+		pages.resize((size + PageSize - 1) >> PageBits);
+	}
+	size_t size() const
+	{
+		return numItems;
+	}
+	bool get(size_t index) const
+	{
+		assert(index < numItems);
+		const auto& page = pages[index >> PageBits];
+		if (page == nullptr) return false;
+		return (page->bits[(index & PageMask) / 64] >> (index & 63)) & 1;
+	}
+	bool operator[](size_t index) const
+	{
+		return get(index);
+	}
+	void set(size_t index, bool value)
+	{
+		assert(index < numItems);
+		auto& page = pages[index >> PageBits];
+		if (page == nullptr)
+		{
+			if (!value) return;
+			page.reset(new Page {});
+		}
+		uint64_t& word = page->bits[(index & PageMask) / 64];
+		uint64_t bit = (uint64_t)1 << (index & 63);
+		if (((word & bit) != 0) == value) return;
+		word ^= bit;
+		if (value)
+		{
+			page->numSet++;
+			return;
+		}
+		assert(page->numSet > 0);
+		page->numSet--;
+		if (page->numSet == 0) page.reset();
+	}
+private:
+	std::vector<std::unique_ptr<Page>> pages;
+	size_t numItems;
+};
+
+#endif
@@ -0,0 +1,362 @@
+#include <cstring>
+#include <unistd.h>
+#include <zlib.h>
+#include "ParallelGzipReader.h"
+#include "CommonUtils.h"
+
+//compressed data is read and handed to the inflater threads in chunks of roughly this size
+const size_t CompressedChunkSize = 1024 * 1024;
+//the streaming inflater produces decompressed chunks of this size
+const size_t DecompressedChunkSize = 4 * 1024 * 1024;
+//maximum number of chunks waiting to be consumed per inflater thread
+const size_t ChunksInFlightPerThread = 4;
+//the BGZF format limits the inflated size of a block to 64kb
+const size_t MaxBgzfInflatedSize = 65536;
+
+namespace
+{
+	bool isGzipHeader(const char* data, size_t size)
+	{
+		return size >= 2 && (unsigned char)data[0] == 0x1f && (unsigned char)data[1] == 0x8b;
+	}
+	//BGZF blocks are gzip members with the block size in a "BC" extra subfield
+	//returns the total size of the block, or 0 if the header is not a BGZF header
+	size_t bgzfBlockSize(const char* data, size_t size)
+	{
+		const unsigned char* bytes = (const unsigned char*)data;
+		if (size < 18) return 0;
+		if (bytes[0] != 0x1f || bytes[1] != 0x8b || bytes[2] != 8 || (bytes[3] & 4) == 0) return 0;
+		size_t extraLength = bytes[10] + (bytes[11] << 8);
+		if (size < 12 + extraLength) return 0;
+		size_t pos = 12;
+		while (pos + 4 <= 12 + extraLength)
+		{
+			size_t subfieldLength = bytes[pos+2] + (bytes[pos+3] << 8);
+			if (bytes[pos] == 'B' && bytes[pos+1] == 'C' && subfieldLength == 2 && pos + 6 <= 12 + extraLength)
+			{
+				return bytes[pos+4] + (bytes[pos+5] << 8) + 1;
+			}
+			pos += 4 + subfieldLength;
+		}
+		return 0;
+	}
+	size_t littleEndian32(const char* data)
+	{
+		const unsigned char* bytes = (const unsigned char*)data;
+		return (size_t)bytes[0] + ((size_t)bytes[1] << 8) + ((size_t)bytes[2] << 16) + ((size_t)bytes[3] << 24);
+	}
+}
+
+ParallelGzipReader::Chunk::Chunk() :
+compressed(),
+blockStarts(),
+decompressed(),
+done(),
+finished(done.get_future())
+{
+}
+
+ParallelGzipReader::ParallelGzipReader(int fd, size_t inflateThreads) :
+fd(fd),
+inflateThreads(std::max(inflateThreads, (size_t)1)),
+inflateQueue(this->inflateThreads * ChunksInFlightPerThread),
+decompressedQueue(this->inflateThreads * ChunksInFlightPerThread),
+currentChunks(),
+currentPos(0),
+errorMutex(),
+error(),
+failed(false),
+readerThread(),
+inflaterThreads()
+{
+	readerThread = std::thread { [this]() { readCompressed(); } };
+}
+
+ParallelGzipReader::~ParallelGzipReader()
+{
+	inflateQueue.close();
+	decompressedQueue.close();
+	readerThread.join();
+	for (size_t i = 0; i < inflaterThreads.size(); i++)
+	{
+		inflaterThreads[i].join();
+	}
+	close(fd);
+}
+
+size_t ParallelGzipReader::read(char* dest, size_t maxBytes)
+{
+	while (currentChunks.size() == 0 || currentPos == currentChunks[0]->decompressed.size())
+	{
+		currentChunks.clear();
+		currentPos = 0;
+		if (decompressedQueue.popBatch(currentChunks, 1) == 0)
+		{
+			std::lock_guard<std::mutex> lock { errorMutex };
+			if (error.size() > 0) throw CommonUtils::InvalidReadFileException { error };
+			return 0;
+		}
+		currentChunks[0]->finished.wait();
+		std::lock_guard<std::mutex> lock { errorMutex };
+		if (error.size() > 0) throw CommonUtils::InvalidReadFileException { error };
+	}
+	size_t copied = std::min(maxBytes, currentChunks[0]->decompressed.size() - currentPos);
+	memcpy(dest, currentChunks[0]->decompressed.data() + currentPos, copied);
+	currentPos += copied;
+	return copied;
+}
+
+void ParallelGzipReader::setError(const std::string& message)
+{
+	{
+		std::lock_guard<std::mutex> lock { errorMutex };
+		if (error.size() == 0) error = message;
+	}
+	failed = true;
+	inflateQueue.close();
+	decompressedQueue.close();
+}
+
+//appends data from the file to the buffer, growing it if needed. returns false at the end of the file
+bool ParallelGzipReader::readMore(std::vector<char>& buffer, size_t& bufferEnd)
+{
+	if (buffer.size() < bufferEnd + CompressedChunkSize) buffer.resize(bufferEnd + CompressedChunkSize);
+	ssize_t got = ::read(fd, buffer.data() + bufferEnd, buffer.size() - bufferEnd);
+	if (got < 0)
+	{
+		setError("Error reading read file");
+		return false;
+	}
+	bufferEnd += got;
+	return got > 0;
+}
+
+void ParallelGzipReader::readCompressed()
+{
+	std::vector<char> buffer;
+	size_t bufferEnd = 0;
+	bool moreData = true;
+	while (bufferEnd < 18 && moreData) moreData = readMore(buffer, bufferEnd);
+	if (bgzfBlockSize(buffer.data(), bufferEnd) > 0)
+	{
+		for (size_t i = 0; i < inflateThreads; i++)
+		{
+			inflaterThreads.emplace_back([this]() { inflateBgzfChunks(); });
+		}
+		while (true)
+		{
+			//stop reading on an error or when the destructor closes the queues
+			if (!splitBgzfBlocks(buffer, bufferEnd, !moreData)) break;
+			if (!moreData || failed) break;
+			moreData = readMore(buffer, bufferEnd);
+		}
+		inflateQueue.close();
+		//the inflater threads are joined in the destructor
+		//the chunks are in order in decompressedQueue, so it can be closed as soon as the last chunk has been queued
+		decompressedQueue.close();
+		return;
+	}
+	if (!isGzipHeader(buffer.data(), bufferEnd))
+	{
+		//not compressed, pass through
+		while (bufferEnd > 0)
+		{
+			buffer.resize(bufferEnd);
+			if (!pushDecompressed(std::move(buffer))) break;
+			buffer.clear();
+			bufferEnd = 0;
+			if (!moreData || failed) break;
+			moreData = readMore(buffer, bufferEnd);
+		}
+		decompressedQueue.close();
+		return;
+	}
+	inflaterThreads.emplace_back([this]() { inflateStream(); });
+	while (bufferEnd > 0)
+	{
+		auto chunk = std::make_shared<Chunk>();
+		buffer.resize(bufferEnd);
+		std::swap(chunk->compressed, buffer);
+		bufferEnd = 0;
+		if (!inflateQueue.push(chunk)) return;
+		if (!moreData || failed) break;
+		moreData = readMore(buffer, bufferEnd);
+	}
+	inflateQueue.close();
+}
+
+//returns false if the queue has been closed
+bool ParallelGzipReader::pushDecompressed(std::vector<char>&& decompressed)
+{
+	auto chunk = std::make_shared<Chunk>();
+	chunk->decompressed = std::move(decompressed);
+	chunk->done.set_value();
+	return decompressedQueue.push(chunk);
+}
+
+//moves the complete BGZF blocks in the buffer to chunks for the inflater threads
+//returns false on an error or if the queues have been closed
+bool ParallelGzipReader::splitBgzfBlocks(std::vector<char>& buffer, size_t& bufferEnd, bool finished)
+{
+	size_t pos = 0;
+	while (pos < bufferEnd)
+	{
+		auto chunk = std::make_shared<Chunk>();
+		size_t chunkStart = pos;
+		while (pos < bufferEnd && chunk->compressed.size() < CompressedChunkSize)
+		{
+			size_t blockSize = bgzfBlockSize(buffer.data() + pos, bufferEnd - pos);
+			if (blockSize == 0 && bufferEnd - pos >= 18)
+			{
+				setError("Invalid BGZF block");
+				return false;
+			}
+			if (blockSize == 0 || pos + blockSize > bufferEnd) break;
+			chunk->blockStarts.push_back(chunk->compressed.size());
+			chunk->compressed.insert(chunk->compressed.end(), buffer.data() + pos, buffer.data() + pos + blockSize);
+			pos += blockSize;
+		}
+		if (chunk->blockStarts.size() == 0) break;
+		if (!finished && chunk->compressed.size() < CompressedChunkSize)
+		{
+			pos = chunkStart;
+			break;
+		}
+		chunk->blockStarts.push_back(chunk->compressed.size());
+		if (!decompressedQueue.push(chunk)) return false;
+		if (!inflateQueue.push(chunk))
+		{
+			chunk->done.set_value();
+			return false;
+		}
+	}
+	if (finished && pos < bufferEnd)
+	{
+		setError("Truncated BGZF file");
+		return false;
+	}
+	//keep the incomplete blocks for the next round
+	memmove(buffer.data(), buffer.data() + pos, bufferEnd - pos);
+	bufferEnd -= pos;
+	return true;
+}
+
+void ParallelGzipReader::inflateBgzfChunks()
+{
+	z_stream stream;
+	memset(&stream, 0, sizeof(stream));
+	bool initialized = inflateInit2(&stream, -15) == Z_OK;
+	if (!initialized) setError("Could not initialize zlib");
+	//empty blocks such as the BGZF EOF marker have no output space, but zlib rejects a null next_out
+	Bytef emptyOutput;
+	std::vector<std::shared_ptr<Chunk>> work;
+	//chunks must be marked done even after an error so the consumer doesn't wait for them forever
+	while (true)
+	{
+		work.clear();
+		if (inflateQueue.popBatch(work, 1) == 0) break;
+		Chunk& chunk = *work[0];
+		for (size_t i = 0; !failed && i + 1 < chunk.blockStarts.size(); i++)
+		{
+			const char* block = chunk.compressed.data() + chunk.blockStarts[i];
+			size_t blockSize = chunk.blockStarts[i+1] - chunk.blockStarts[i];
+			size_t headerSize = 12 + (unsigned char)block[10] + ((unsigned char)block[11] << 8);
+			size_t inflatedSize = littleEndian32(block + blockSize - 4);
+			size_t expectedCrc = littleEndian32(block + blockSize - 8);
+			//a corrupt trailer must not make us allocate gigabytes
+			if (inflatedSize > MaxBgzfInflatedSize || headerSize + 8 > blockSize)
+			{
+				setError("Corrupted BGZF block");
+				break;
+			}
+			size_t outputStart = chunk.decompressed.size();
+			chunk.decompressed.resize(outputStart + inflatedSize);
+			inflateReset(&stream);
+			stream.next_in = (Bytef*)(block + headerSize);
+			stream.avail_in = blockSize - headerSize - 8;
+			stream.next_out = inflatedSize > 0 ? (Bytef*)(chunk.decompressed.data() + outputStart) : &emptyOutput;
+			stream.avail_out = inflatedSize;
+			int result = inflate(&stream, Z_FINISH);
+			if (result != Z_STREAM_END || stream.avail_out != 0 || crc32(0, (const Bytef*)chunk.decompressed.data() + outputStart, inflatedSize) != expectedCrc)
+			{
+				setError("Corrupted BGZF block");
+				break;
+			}
+		}
+		std::vector<char>().swap(chunk.compressed);
+		chunk.done.set_value();
+	}
+	if (initialized) inflateEnd(&stream);
+}
+
+void ParallelGzipReader::inflateStream()
+{
+	z_stream stream;
+	memset(&stream, 0, sizeof(stream));
+	//32 detects the gzip header
+	if (inflateInit2(&stream, 15 + 32) != Z_OK)
+	{
+		setError("Could not initialize zlib");
+		return;
+	}
+	std::vector<char> output;
+	output.resize(DecompressedChunkSize);
+	stream.next_out = (Bytef*)output.data();
+	stream.avail_out = output.size();
+	bool memberFinished = false;
+	bool ignoreRest = false;
+	std::vector<std::shared_ptr<Chunk>> work;
+	while (!ignoreRest)
+	{
+		work.clear();
+		if (inflateQueue.popBatch(work, 1) == 0) break;
+		Chunk& chunk = *work[0];
+		stream.next_in = (Bytef*)chunk.compressed.data();
+		stream.avail_in = chunk.compressed.size();
+		while (stream.avail_in > 0)
+		{
+			if (memberFinished)
+			{
+				//concatenated gzip members. anything else after a member is ignored, like gzip does
+				if (!isGzipHeader((const char*)stream.next_in, stream.avail_in) && stream.avail_in >= 2)
+				{
+					ignoreRest = true;
+					break;
+				}
+				inflateReset(&stream);
+				memberFinished = false;
+			}
+			int result = inflate(&stream, Z_NO_FLUSH);
+			if (result == Z_STREAM_END)
+			{
+				memberFinished = true;
+			}
+			else if (result != Z_OK && result != Z_BUF_ERROR)
+			{
+				setError("Corrupted gzip file");
+				inflateEnd(&stream);
+				return;
+			}
+			if (stream.avail_out == 0)
+			{
+				if (!pushDecompressed(std::move(output)))
+				{
+					inflateEnd(&stream);
+					return;
+				}
+				output.resize(DecompressedChunkSize);
+				stream.next_out = (Bytef*)output.data();
+				stream.avail_out = output.size();
+			}
+		}
+	}
+	if (!memberFinished && !ignoreRest)
+	{
+		std::lock_guard<std::mutex> lock { errorMutex };
+		if (error.size() == 0) error = "Truncated gzip file";
+	}
+	output.resize(output.size() - stream.avail_out);
+	if (output.size() > 0) pushDecompressed(std::move(output));
+	inflateEnd(&stream);
+	decompressedQueue.close();
+}
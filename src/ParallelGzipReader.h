@@ -0,0 +1,58 @@
+#ifndef ParallelGzipReader_h
+#define ParallelGzipReader_h
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <future>
+#include <mutex>
+#include <atomic>
+#include "BlockingQueue.h"
+
+//decompresses a gzip stream using multiple threads
+//BGZF files are inflated block-parallel with inflateThreads threads
+//other gzip files are read and inflated by a pipelined reader / inflater thread pair
+//uncompressed input is passed through as-is
+class ParallelGzipReader
+{
+	struct Chunk
+	{
+		Chunk();
+		std::vector<char> compressed;
+		std::vector<size_t> blockStarts;
+		std::vector<char> decompressed;
+		std::promise<void> done;
+		std::future<void> finished;
+	};
+public:
+	//takes ownership of the file descriptor
+	ParallelGzipReader(int fd, size_t inflateThreads);
+	~ParallelGzipReader();
+	ParallelGzipReader(const ParallelGzipReader& other) = delete;
+	ParallelGzipReader& operator=(const ParallelGzipReader& other) = delete;
+	//copies at most maxBytes bytes of decompressed data to dest. returns 0 at the end of the stream
+	size_t read(char* dest, size_t maxBytes);
+private:
+	void readCompressed();
+	bool readMore(std::vector<char>& buffer, size_t& bufferEnd);
+	bool splitBgzfBlocks(std::vector<char>& buffer, size_t& bufferEnd, bool finished);
+	void inflateBgzfChunks();
+	void inflateStream();
+	bool pushDecompressed(std::vector<char>&& decompressed);
+	void setError(const std::string& message);
+	int fd;
+	size_t inflateThreads;
+	BlockingQueue<std::shared_ptr<Chunk>> inflateQueue;
+	BlockingQueue<std::shared_ptr<Chunk>> decompressedQueue;
+	std::vector<std::shared_ptr<Chunk>> currentChunks;
+	size_t currentPos;
+	std::mutex errorMutex;
+	std::string error;
+	std::atomic<bool> failed;
+	std::thread readerThread;
+	//only modified by the reader thread
+	std::vector<std::thread> inflaterThreads;
+};
+
+#endif
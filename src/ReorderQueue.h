@@ -0,0 +1,81 @@
+#ifndef ReorderQueue_h
+#define ReorderQueue_h
+
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+//multi-producer single-consumer queue which returns items in the order of their sequence numbers
+//items are pushed with sequence numbers 0, 1, 2... in any order, and popped in order
+//push blocks while the item is more than window items ahead of the next item to be popped
+//close() marks the end of the stream, after which popBatch returns 0 once the consecutive items have been popped
+template <typename T>
+class ReorderQueue
+{
+public:
+	ReorderQueue(size_t window) :
+	slots(window),
+	present(window, false),
+	nextNumber(0),
+	closed(false),
+	queueMutex(),
+	nextAvailable(),
+	windowMoved()
+	{
+	}
+	ReorderQueue(const ReorderQueue& other) = delete;
+	ReorderQueue& operator=(const ReorderQueue& other) = delete;
+	bool push(size_t sequenceNumber, T item)
+	{
+		bool isNext = false;
+		{
+			std::unique_lock<std::mutex> lock { queueMutex };
+			windowMoved.wait(lock, [this, sequenceNumber]() { return closed || sequenceNumber < nextNumber + slots.size(); });
+			if (closed) return false;
+			size_t slot = sequenceNumber % slots.size();
+			slots[slot] = std::move(item);
+			present[slot] = true;
+			isNext = sequenceNumber == nextNumber;
+		}
+		if (isNext) nextAvailable.notify_one();
+		return true;
+	}
+	//moves at least one and at most maxCount consecutive items to the end of result
+	size_t popBatch(std::vector<T>& result, size_t maxCount)
+	{
+		size_t popped = 0;
+		{
+			std::unique_lock<std::mutex> lock { queueMutex };
+			nextAvailable.wait(lock, [this]() { return closed || present[nextNumber % slots.size()]; });
+			while (popped < maxCount && present[nextNumber % slots.size()])
+			{
+				size_t slot = nextNumber % slots.size();
+				result.emplace_back(std::move(slots[slot]));
+				present[slot] = false;
+				nextNumber += 1;
+				popped += 1;
+			}
+		}
+		if (popped > 0) windowMoved.notify_all();
+		return popped;
+	}
+	void close()
+	{
+		{
+			std::lock_guard<std::mutex> lock { queueMutex };
+			closed = true;
+		}
+		nextAvailable.notify_all();
+		windowMoved.notify_all();
+	}
+private:
+	std::vector<T> slots;
+	std::vector<bool> present;
+	size_t nextNumber;
+	bool closed;
+	std::mutex queueMutex;
+	std::condition_variable nextAvailable;
+	std::condition_variable windowMoved;
+};
+
+#endif
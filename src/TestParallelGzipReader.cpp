@@ -0,0 +1,164 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <random>
+#include <unistd.h>
+#include <zlib.h>
+#include "ParallelGzipReader.h"
+#include "CommonUtils.h"
+
+//regression tests for the BGZF path of ParallelGzipReader
+//usage: TestParallelGzipReader. exits with a nonzero status if a test fails
+
+namespace
+{
+	//the 28 byte empty block bgzip writes at the end of every file
+	const unsigned char BgzfEofMarker[28] = { 0x1f, 0x8b, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x06, 0x00, 0x42, 0x43, 0x02, 0x00, 0x1b, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+
+	void appendLittleEndian(std::vector<unsigned char>& result, size_t value, size_t bytes)
+	{
+		for (size_t i = 0; i < bytes; i++)
+		{
+			result.push_back((value >> (i * 8)) & 0xFF);
+		}
+	}
+
+	std::vector<unsigned char> bgzfBlock(const std::string& data)
+	{
+		std::vector<unsigned char> deflated;
+		deflated.resize(compressBound(data.size()) + 64);
+		z_stream stream {};
+		deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+		stream.next_in = (Bytef*)data.data();
+		stream.avail_in = data.size();
+		stream.next_out = deflated.data();
+		stream.avail_out = deflated.size();
+		deflate(&stream, Z_FINISH);
+		deflated.resize(deflated.size() - stream.avail_out);
+		deflateEnd(&stream);
+		std::vector<unsigned char> result { 0x1f, 0x8b, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x06, 0x00, 0x42, 0x43, 0x02, 0x00 };
+		appendLittleEndian(result, 18 + deflated.size() + 8 - 1, 2);
+		result.insert(result.end(), deflated.begin(), deflated.end());
+		appendLittleEndian(result, crc32(0, (const Bytef*)data.data(), data.size()), 4);
+		appendLittleEndian(result, data.size(), 4);
+		return result;
+	}
+
+	std::string readAll(const std::vector<unsigned char>& file)
+	{
+		char filename[] = "/tmp/TestParallelGzipReaderXXXXXX";
+		int fd = mkstemp(filename);
+		if (fd == -1) throw std::runtime_error { "Could not create temporary file" };
+		unlink(filename);
+		if (write(fd, file.data(), file.size()) != (ssize_t)file.size()) throw std::runtime_error { "Could not write temporary file" };
+		lseek(fd, 0, SEEK_SET);
+		ParallelGzipReader reader { fd, 2 };
+		std::string result;
+		char buffer[4096];
+		while (true)
+		{
+			size_t got = reader.read(buffer, sizeof(buffer));
+			if (got == 0) break;
+			result.insert(result.end(), buffer, buffer + got);
+		}
+		return result;
+	}
+
+	bool check(const std::string& name, const std::vector<unsigned char>& file, const std::string& expected)
+	{
+		try
+		{
+			std::string got = readAll(file);
+			if (got == expected) return true;
+			std::cerr << name << ": expected " << expected.size() << " bytes, got " << got.size() << std::endl;
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << name << ": " << e.what() << std::endl;
+		}
+		return false;
+	}
+
+	bool checkError(const std::string& name, const std::vector<unsigned char>& file, const std::string& expectedError)
+	{
+		try
+		{
+			std::string got = readAll(file);
+			std::cerr << name << ": expected an error, got " << got.size() << " bytes" << std::endl;
+		}
+		catch (const std::exception& e)
+		{
+			if (e.what() == expectedError) return true;
+			std::cerr << name << ": expected error \"" << expectedError << "\", got \"" << e.what() << "\"" << std::endl;
+		}
+		return false;
+	}
+
+	//the write end of the pipe stays open, so the reader thread would block forever if it kept reading after the error
+	bool checkStopsAfterError(const std::string& name, const std::vector<unsigned char>& file)
+	{
+		int fds[2];
+		if (pipe(fds) == -1) throw std::runtime_error { "Could not create pipe" };
+		if (write(fds[1], file.data(), file.size()) != (ssize_t)file.size()) throw std::runtime_error { "Could not write pipe" };
+		bool threw = false;
+		{
+			ParallelGzipReader reader { fds[0], 2 };
+			char buffer[4096];
+			try
+			{
+				while (reader.read(buffer, sizeof(buffer)) > 0);
+			}
+			catch (const std::exception& e)
+			{
+				threw = true;
+			}
+		}
+		close(fds[1]);
+		if (!threw) std::cerr << name << ": expected an error" << std::endl;
+		return threw;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	bool ok = true;
+	std::vector<unsigned char> eofOnly { BgzfEofMarker, BgzfEofMarker + sizeof(BgzfEofMarker) };
+	ok = check("EOF marker only", eofOnly, "") && ok;
+
+	std::string reads = "@read1\nACGT\n+\nIIII\n";
+	std::vector<unsigned char> withData = bgzfBlock(reads);
+	withData.insert(withData.end(), eofOnly.begin(), eofOnly.end());
+	ok = check("data block and EOF marker", withData, reads) && ok;
+
+	//data blocks which just fill one chunk, so the EOF marker is alone in the last chunk
+	std::mt19937 rand { 1 };
+	std::string bigData;
+	std::vector<unsigned char> chunkThenEof;
+	while (chunkThenEof.size() < 1024 * 1024)
+	{
+		std::string blockData;
+		for (size_t j = 0; j < 60000; j++) blockData += (char)(rand() & 0xFF);
+		auto block = bgzfBlock(blockData);
+		chunkThenEof.insert(chunkThenEof.end(), block.begin(), block.end());
+		bigData += blockData;
+	}
+	chunkThenEof.insert(chunkThenEof.end(), eofOnly.begin(), eofOnly.end());
+	ok = check("full chunk then EOF marker", chunkThenEof, bigData) && ok;
+
+	std::vector<unsigned char> hugeSize = bgzfBlock(reads);
+	for (size_t i = hugeSize.size() - 4; i < hugeSize.size(); i++) hugeSize[i] = 0xFF;
+	hugeSize.insert(hugeSize.end(), eofOnly.begin(), eofOnly.end());
+	ok = checkError("inflated size over 64kb", hugeSize, "Corrupted BGZF block") && ok;
+
+	//the default SIGALRM action kills the test if the reader hangs
+	alarm(60);
+	std::vector<unsigned char> invalidBlock = bgzfBlock(reads);
+	invalidBlock.insert(invalidBlock.end(), 32, 'x');
+	ok = checkStopsAfterError("invalid block in a pipe", invalidBlock) && ok;
+	alarm(0);
+
+	if (!ok) return 1;
+	std::cerr << "all tests passed" << std::endl;
+	return 0;
+}
@@ -143,6 +143,36 @@ public:
 	}
 };
 
+//twice as many rows per slice. the operations compile to pairs of 64-bit instructions
+template <>
+class WordConfiguration<__uint128_t>
+{
+public:
+	static constexpr int WordSize = 128;
+	static constexpr int ChunkBits = 8;
+	static constexpr __uint128_t AllZeros = 0;
+	static constexpr __uint128_t AllOnes = ~(__uint128_t)0;
+	static constexpr __uint128_t LastBit = (__uint128_t)1 << 127;
+	static constexpr __uint128_t SignMask = ((__uint128_t)WordConfiguration<uint64_t>::SignMask << 64) | WordConfiguration<uint64_t>::SignMask;
+	static constexpr __uint128_t PrefixSumMultiplierConstant = ((__uint128_t)WordConfiguration<uint64_t>::PrefixSumMultiplierConstant << 64) | WordConfiguration<uint64_t>::PrefixSumMultiplierConstant;
+	static constexpr __uint128_t LSBMask = ((__uint128_t)WordConfiguration<uint64_t>::LSBMask << 64) | WordConfiguration<uint64_t>::LSBMask;
+
+	static int popcount(__uint128_t x)
+	{
+		return WordConfiguration<uint64_t>::popcount((uint64_t)x) + WordConfiguration<uint64_t>::popcount((uint64_t)(x >> 64));
+	}
+
+	static __uint128_t ChunkPopcounts(__uint128_t value)
+	{
+		return ((__uint128_t)WordConfiguration<uint64_t>::ChunkPopcounts((uint64_t)(value >> 64)) << 64) | WordConfiguration<uint64_t>::ChunkPopcounts((uint64_t)value);
+	}
+
+	static int BitPosition(__uint128_t number, int rank)
+	{
+		return WordConfiguration<uint64_t>::BitPosition((uint64_t)number, (uint64_t)(number >> 64), rank);
+	}
+};
+
 //uncomment if there's an undefined reference with -O0. why?
 // constexpr uint64_t WordConfiguration<uint64_t>::AllZeros;
 // constexpr uint64_t WordConfiguration<uint64_t>::AllOnes;
@@ -254,7 +284,8 @@ private:
 	{
 		ScoreType scoreBeforeStart = getScoreBeforeStart();
 		//rightmost VP between any VN's, aka one cell to the left of a minimum
-		Word priorityCausedMinima = 0xAAAAAAAAAAAAAAAA & ~VP & ~VN;
+		//every other bit, 0xAAAA...
+		Word priorityCausedMinima = ((WordConfiguration<Word>::AllOnes / 3) << 1) & ~VP & ~VN;
 		priorityCausedMinima |= VN;
 		Word possibleLocalMinima = (VP & (priorityCausedMinima - VP));
 		//shift right by one to get the minimum
@@ -367,7 +398,6 @@ private:
 	static WordSlice mergeTwoSlices(WordSlice left, WordSlice right)
 	{
 		//O(log w), because prefix sums need log w chunks of log w bits
-		static_assert(std::is_same<Word, uint64_t>::value);
 		if (left.getScoreBeforeStart() > right.getScoreBeforeStart()) std::swap(left, right);
 		assert((left.VP & left.VN) == WordConfiguration<Word>::AllZeros);
 		assert((right.VP & right.VN) == WordConfiguration<Word>::AllZeros);
@@ -386,8 +416,8 @@ private:
 		assert((right.VP & right.VN) == WordConfiguration<Word>::AllZeros);
 		assert((leftSmaller & rightSmaller) == 0);
 		auto mask = (rightSmaller | ((leftSmaller | rightSmaller) - (rightSmaller << 1))) & ~leftSmaller;
-		uint64_t leftReduction = leftSmaller & (rightSmaller << 1);
-		uint64_t rightReduction = rightSmaller & (leftSmaller << 1);
+		Word leftReduction = leftSmaller & (rightSmaller << 1);
+		Word rightReduction = rightSmaller & (leftSmaller << 1);
 		if ((rightSmaller & 1) && left.getScoreBeforeStart() < right.getScoreBeforeStart())
 		{
 			rightReduction |= 1;
@@ -408,13 +438,17 @@ private:
 #ifdef NDEBUG
 	__attribute__((always_inline))
 #endif
-	static std::pair<uint64_t, uint64_t> differenceMasks(uint64_t leftVP, uint64_t leftVN, uint64_t rightVP, uint64_t rightVN, int scoreDifference)
+	static std::pair<Word, Word> differenceMasks(Word leftVP, Word leftVN, Word rightVP, Word rightVN, int scoreDifference)
 	{
 		auto result = differenceMasksBitTwiddle(leftVP, leftVN, rightVP, rightVN, scoreDifference);
 #ifdef EXTRACORRECTNESSASSERTIONS
-		auto debugCompare = differenceMasksWord(leftVP, leftVN, rightVP, rightVN, scoreDifference);
-		assert(result.first == debugCompare.first);
-		assert(result.second == debugCompare.second);
+		//the chunked prefix sum version is written for 64-bit words
+		if (std::is_same<Word, uint64_t>::value)
+		{
+			auto debugCompare = differenceMasksWord(leftVP, leftVN, rightVP, rightVN, scoreDifference);
+			assert(result.first == debugCompare.first);
+			assert(result.second == debugCompare.second);
+		}
 #endif
 		return result;
 	}
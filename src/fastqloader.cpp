@@ -1,13 +1,318 @@
 #include <algorithm>
 #include <fstream>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "fastqloader.h"
 #include "CommonUtils.h"
+#include "ParallelGzipReader.h"
+
+//gzipped input is parsed this many bytes at a time. the buffer grows if a single read doesn't fit
+const size_t ReadBufferInitialSize = 4 * 1024 * 1024;
+//memory mapped input which has already been parsed is dropped from memory in chunks of this size
+const size_t MappedReleaseChunkSize = 64 * 1024 * 1024;
+
+namespace
+{
+	const char* lineEnd(const char* start, const char* end)
+	{
+		const char* found = (const char*)memchr(start, '\n', end - start);
+		if (found == nullptr) return end;
+		return found;
+	}
+	const char* withoutCarriageReturn(const char* start, const char* end)
+	{
+		if (end > start && *(end-1) == '\r') return end-1;
+		return end;
+	}
+}
+
+FastqReader::FastqReader(const std::string& filename, bool includeQuality, size_t decompressionThreads) :
+filename(filename),
+includeQuality(includeQuality),
+format(Format::Unknown),
+fd(-1),
+gzipReader(),
+mapped(nullptr),
+mappedSize(0),
+releasedUntil(0),
+buffer(),
+data(nullptr),
+dataPos(0),
+dataSize(0),
+sourceFinished(false)
+{
+	fd = open(filename.c_str(), O_RDONLY);
+	if (fd == -1) throw CommonUtils::InvalidReadFileException { "Could not open read file " + filename };
+	struct stat fileStat;
+	bool regularFile = fstat(fd, &fileStat) == 0 && S_ISREG(fileStat.st_mode);
+	if (regularFile && fileStat.st_size == 0)
+	{
+		sourceFinished = true;
+		return;
+	}
+	bool gzipped = true;
+	if (regularFile)
+	{
+		unsigned char magic[2] { 0, 0 };
+		gzipped = pread(fd, magic, 2, 0) == 2 && magic[0] == 0x1f && magic[1] == 0x8b;
+	}
+	if (!gzipped)
+	{
+		void* map = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map != MAP_FAILED)
+		{
+			madvise(map, fileStat.st_size, MADV_SEQUENTIAL);
+			mapped = (const char*)map;
+			mappedSize = fileStat.st_size;
+			data = mapped;
+			dataSize = mappedSize;
+			sourceFinished = true;
+		}
+	}
+	if (mapped == nullptr)
+	{
+		//also handles pipes and uncompressed files which can't be mapped, uncompressed data is passed through as-is
+		gzipReader = std::make_unique<ParallelGzipReader>(fd, decompressionThreads);
+		fd = -1;
+		buffer.resize(ReadBufferInitialSize);
+		data = buffer.data();
+	}
+	detectFormat();
+}
+
+std::unique_ptr<FastqReader> FastqReader::tryOpen(const std::string& filename, bool includeQuality, size_t decompressionThreads)
+{
+	try
+	{
+		return std::make_unique<FastqReader>(filename, includeQuality, decompressionThreads);
+	}
+	catch (const CommonUtils::InvalidReadFileException& e)
+	{
+		return nullptr;
+	}
+}
+
+FastqReader::~FastqReader()
+{
+	if (mapped != nullptr) munmap((void*)mapped, mappedSize);
+	if (fd != -1) close(fd);
+}
+
+void FastqReader::detectFormat()
+{
+	while (true)
+	{
+		while (dataPos < dataSize && isspace(data[dataPos])) dataPos++;
+		if (dataPos < dataSize) break;
+		if (sourceFinished) return;
+		refill();
+	}
+	switch(data[dataPos])
+	{
+		case '@':
+			format = Format::Fastq;
+			break;
+		case '>':
+			format = Format::Fasta;
+			break;
+		default:
+			throw CommonUtils::InvalidReadFileException { "Unknown read file format, expected fasta or fastq: " + filename };
+	}
+}
+
+//moves the unparsed data to the start of the buffer and reads more after it
+//invalidates pointers to the buffer
+void FastqReader::refill()
+{
+	size_t remaining = dataSize - dataPos;
+	if (remaining > 0 && dataPos > 0) memmove(buffer.data(), buffer.data() + dataPos, remaining);
+	dataPos = 0;
+	dataSize = remaining;
+	if (buffer.size() - dataSize < buffer.size() / 2) buffer.resize(buffer.size() * 2);
+	data = buffer.data();
+	size_t got = 0;
+	try
+	{
+		got = gzipReader->read(buffer.data() + dataSize, buffer.size() - dataSize);
+	}
+	catch (const CommonUtils::InvalidReadFileException& e)
+	{
+		throw CommonUtils::InvalidReadFileException { std::string { e.what() } + ": " + filename };
+	}
+	if (got == 0) sourceFinished = true;
+	dataSize += got;
+}
+
+void FastqReader::releaseParsed()
+{
+	if (mapped == nullptr) return;
+	if (dataPos < releasedUntil + MappedReleaseChunkSize) return;
+	size_t pageSize = sysconf(_SC_PAGESIZE);
+	size_t releaseEnd = dataPos / pageSize * pageSize;
+	madvise((void*)(mapped + releasedUntil), releaseEnd - releasedUntil, MADV_DONTNEED);
+	releasedUntil = releaseEnd;
+}
+
+bool FastqReader::next(FastQ& result)
+{
+	switch(format)
+	{
+		case Format::Fasta:
+			return nextFasta(result);
+		case Format::Fastq:
+			return nextFastq(result);
+		case Format::Unknown:
+			return false;
+	}
+	return false;
+}
+
+bool FastqReader::nextFastq(FastQ& result)
+{
+	while (true)
+	{
+		const char* start = data + dataPos;
+		const char* end = data + dataSize;
+		if (start == end)
+		{
+			if (sourceFinished) return false;
+			refill();
+			continue;
+		}
+		if (*start != '@')
+		{
+			const char* skip = lineEnd(start, end);
+			if (skip == end && !sourceFinished)
+			{
+				refill();
+				continue;
+			}
+			dataPos = std::min(skip + 1, end) - data;
+			continue;
+		}
+		const char* lineEnds[4];
+		const char* pos = start;
+		size_t foundLines = 0;
+		for (; foundLines < 4; foundLines++)
+		{
+			lineEnds[foundLines] = lineEnd(pos, end);
+			if (lineEnds[foundLines] == end) break;
+			pos = lineEnds[foundLines] + 1;
+		}
+		if (foundLines < 4 && !sourceFinished)
+		{
+			refill();
+			continue;
+		}
+		if (foundLines < 4)
+		{
+			//no newline at the end of the file
+			if (foundLines < 1) return false;
+			for (size_t i = foundLines+1; i < 4; i++) lineEnds[i] = end;
+		}
+		const char* sequenceStart = lineEnds[0] + 1;
+		const char* qualityStart = std::min(lineEnds[2] + 1, end);
+		result.seq_id.assign(start + 1, withoutCarriageReturn(start + 1, lineEnds[0]));
+		result.sequence.assign(sequenceStart, withoutCarriageReturn(sequenceStart, lineEnds[1]));
+		if (includeQuality)
+		{
+			result.quality.assign(qualityStart, withoutCarriageReturn(qualityStart, lineEnds[3]));
+		}
+		else
+		{
+			result.quality.clear();
+		}
+		dataPos = std::min(lineEnds[3] + 1, end) - data;
+		releaseParsed();
+		return true;
+	}
+}
+
+bool FastqReader::nextFasta(FastQ& result)
+{
+	while (true)
+	{
+		const char* start = data + dataPos;
+		const char* end = data + dataSize;
+		if (start == end)
+		{
+			if (sourceFinished) return false;
+			refill();
+			continue;
+		}
+		if (*start != '>')
+		{
+			const char* skip = lineEnd(start, end);
+			if (skip == end && !sourceFinished)
+			{
+				refill();
+				continue;
+			}
+			dataPos = std::min(skip + 1, end) - data;
+			continue;
+		}
+		const char* headerEnd = lineEnd(start, end);
+		if (headerEnd == end && !sourceFinished)
+		{
+			refill();
+			continue;
+		}
+		//the record ends at the next '>' which starts a line
+		const char* recordEnd = nullptr;
+		const char* pos = headerEnd;
+		while (pos < end)
+		{
+			const char* found = (const char*)memchr(pos, '>', end - pos);
+			if (found == nullptr) break;
+			if (*(found-1) == '\n')
+			{
+				recordEnd = found;
+				break;
+			}
+			pos = found + 1;
+		}
+		if (recordEnd == nullptr && !sourceFinished)
+		{
+			refill();
+			continue;
+		}
+		if (recordEnd == nullptr) recordEnd = end;
+		result.seq_id.assign(start + 1, withoutCarriageReturn(start + 1, headerEnd));
+		result.sequence.clear();
+		if (headerEnd < recordEnd)
+		{
+			result.sequence.reserve(recordEnd - headerEnd);
+			pos = headerEnd + 1;
+			while (pos < recordEnd)
+			{
+				const char* lineStop = lineEnd(pos, recordEnd);
+				result.sequence.append(pos, withoutCarriageReturn(pos, lineStop));
+				pos = lineStop + 1;
+			}
+		}
+		if (includeQuality)
+		{
+			result.quality.assign(result.sequence.size(), '!');
+		}
+		else
+		{
+			result.quality.clear();
+		}
+		dataPos = recordEnd - data;
+		releaseParsed();
+		return true;
+	}
+}
 
 std::vector<FastQ> loadFastqFromFile(std::string filename, bool includeQuality)
 {
 	std::vector<FastQ> result;
-	FastQ::streamFastqFromFile(filename, includeQuality, [&result](FastQ& fq) {
-		result.emplace_back(std::move(fq));
+	//copied so the reader keeps reusing the buffers of its read
+	FastQ::streamFastqFromFile(filename, includeQuality, [&result](const FastQ& fq) {
+		result.push_back(fq);
 	});
 	return result;
 }
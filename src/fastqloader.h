@@ -3,129 +3,62 @@
 
 #include <string>
 #include <vector>
-#include <zstr.hpp> //https://github.com/mateidavid/zstr
+#include <memory>
 
-class FastQ {
+class FastQ;
+class ParallelGzipReader;
+
+//reads fasta and fastq files, either uncompressed or gzipped
+//the format and the compression are detected from the file contents
+//uncompressed files are memory mapped, gzipped files are inflated in the background by decompressionThreads threads
+class FastqReader
+{
 public:
-	template <typename F>
-	static void streamFastqFastqFromStream(std::istream& file, bool includeQuality, F f)
-	{
-		do
-		{
-			std::string line;
-			std::getline(file, line);
-			if (line[0] != '@') continue;
-			FastQ newread;
-			if (line.back() == '\r') line.pop_back();
-			newread.seq_id = line.substr(1);
-			std::getline(file, line);
-			if (line.back() == '\r') line.pop_back();
-			newread.sequence = line;
-			std::getline(file, line);
-			std::getline(file, line);
-			if (line.back() == '\r') line.pop_back();
-			if (includeQuality) newread.quality = line;
-			f(newread);
-		} while (file.good());
-	}
-	template <typename F>
-	static void streamFastqFastaFromStream(std::istream& file, bool includeQuality, F f)
+	FastqReader(const std::string& filename, bool includeQuality, size_t decompressionThreads = 1);
+	//returns null instead of throwing if the file can't be opened or isn't fasta or fastq
+	static std::unique_ptr<FastqReader> tryOpen(const std::string& filename, bool includeQuality, size_t decompressionThreads = 1);
+	~FastqReader();
+	FastqReader(const FastqReader& other) = delete;
+	FastqReader& operator=(const FastqReader& other) = delete;
+	//overwrites result with the next read, reusing its buffers. returns false at the end of the file
+	bool next(FastQ& result);
+private:
+	enum Format
 	{
-		std::string line;
-		std::getline(file, line);
-		do
-		{
-			if (line[0] != '>')
-			{
-				std::getline(file, line);
-				continue;
-			}
-			FastQ newread;
-			if (line.back() == '\r') line.pop_back();
-			newread.seq_id = line.substr(1);
-			newread.sequence = "";
-			do
-			{
-				std::getline(file, line);
-				if (line[0] == '>') break;
-				if (line.back() == '\r') line.pop_back();
-				newread.sequence += line;
-			} while (file.good());
-			if (includeQuality)
-			{
-				for (size_t i = 0; i < newread.sequence.size(); i++)
-				{
-					newread.quality += '!';
-				}
-			}
-			f(newread);
-		} while (file.good());
-	}
-	template <typename F>
-	static void streamFastqFastqFromFile(std::string filename, bool includeQuality, F f)
-	{
-		std::ifstream file {filename};
-		streamFastqFastqFromStream(file, includeQuality, f);
-	}
-	template <typename F>
-	static void streamFastqFastaFromFile(std::string filename, bool includeQuality, F f)
-	{
-		std::ifstream file {filename};
-		streamFastqFastaFromStream(file, includeQuality, f);
-	}
-	template <typename F>
-	static void streamFastqFastqFromGzippedFile(std::string filename, bool includeQuality, F f)
-	{
-		zstr::ifstream file { filename };
-		streamFastqFastqFromStream(file, includeQuality, f);
-	}
-	template <typename F>
-	static void streamFastqFastaFromGzippedFile(std::string filename, bool includeQuality, F f)
-	{
-		zstr::ifstream file { filename };
-		streamFastqFastaFromStream(file, includeQuality, f);
-	}
+		Unknown, Fasta, Fastq
+	};
+	bool nextFasta(FastQ& result);
+	bool nextFastq(FastQ& result);
+	void refill();
+	void releaseParsed();
+	void detectFormat();
+	std::string filename;
+	bool includeQuality;
+	Format format;
+	int fd;
+	std::unique_ptr<ParallelGzipReader> gzipReader;
+	const char* mapped;
+	size_t mappedSize;
+	size_t releasedUntil;
+	std::vector<char> buffer;
+	const char* data;
+	size_t dataPos;
+	size_t dataSize;
+	bool sourceFinished;
+};
+
+class FastQ {
+public:
+	//a missing or unrecognized file gives no reads, like the stream loaders before FastqReader
 	template <typename F>
 	static void streamFastqFromFile(std::string filename, bool includeQuality, F f)
 	{
-		bool gzipped = false;
-		std::string originalFilename = filename;
-		if (filename.substr(filename.size()-3) == ".gz")
-		{
-			gzipped = true;
-			filename = filename.substr(0, filename.size()-3);
-		}
-		bool fastq = false;
-		bool fasta = false;
-		if (filename.substr(filename.size()-6) == ".fastq") fastq = true;
-		if (filename.substr(filename.size()-3) == ".fq") fastq = true;
-		if (filename.substr(filename.size()-6) == ".fasta") fasta = true;
-		if (filename.substr(filename.size()-3) == ".fa") fasta = true;
-		if (fasta)
-		{
-			if (gzipped)
-			{
-				streamFastqFastaFromGzippedFile(originalFilename, includeQuality, f);
-				return;
-			}
-			else
-			{
-				streamFastqFastaFromFile(originalFilename, includeQuality, f);
-				return;
-			}
-		}
-		if (fastq)
+		auto reader = FastqReader::tryOpen(filename, includeQuality);
+		if (reader == nullptr) return;
+		FastQ read;
+		while (reader->next(read))
 		{
-			if (gzipped)
-			{
-				streamFastqFastqFromGzippedFile(originalFilename, includeQuality, f);
-				return;
-			}
-			else
-			{
-				streamFastqFastqFromFile(originalFilename, includeQuality, f);
-				return;
-			}
+			f(read);
 		}
 	}
 	FastQ reverseComplement() const;